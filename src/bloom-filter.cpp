@@ -1,11 +1,16 @@
 #include "bloom-filter.hpp"
+#include "cuckoo-filter.hpp"
+#include "simd.hpp"
 #include "util.hpp"
 
 #include <algorithm>
+#include <bitset>
 #include <cmath>
 #include <cstddef>
 #include <iterator>
 #include <limits>
+#include <map>
+#include <tuple>
 #include <cstdlib>
 #include <cassert>
 #include <iostream>
@@ -23,11 +28,47 @@ bloom_parameters::bloom_parameters()
 , projected_element_count(200)
 , false_positive_probability(1.0 / projected_element_count)
 , random_seed(0xA5A5A5A55A5A5A5AULL)
+, type(bloom_filter_salted)
 {}
 
 bool
 bloom_parameters::compute_optimal_parameters()
 {
+  // Producers compute this for every sync interest, and consumers keep
+  // sending the same parameters, so the results are remembered. The cache is
+  // dropped when full so that odd interests cannot grow it without bound.
+  typedef std::tuple<unsigned int, unsigned int, unsigned int, unsigned int, unsigned int,
+                     double, int> cache_key;
+  static const std::size_t max_cache_size = 256;
+  static std::map<cache_key, optimal_parameters_t> cache;
+
+  cache_key key(minimum_size, maximum_size, minimum_number_of_hashes, maximum_number_of_hashes,
+                projected_element_count, false_positive_probability, type);
+  auto cached = cache.find(key);
+  if (cached != cache.end())
+  {
+    optimal_parameters = cached->second;
+    return true;
+  }
+
+  optimal_parameters_t& optp = optimal_parameters;
+
+  if (type == bloom_filter_cuckoo)
+  {
+    unsigned int fingerprint_bits = 0;
+    std::size_t bucket_count = 0;
+    cuckoo_compute_parameters(projected_element_count, false_positive_probability,
+                              fingerprint_bits, bucket_count);
+    optp.number_of_hashes = fingerprint_bits;
+    optp.table_size = bucket_count * cuckoo_bucket_size * fingerprint_bits;
+    optp.table_size += (((optp.table_size % bits_per_char) != 0) ? (bits_per_char - (optp.table_size % bits_per_char)) : 0);
+
+    if (cache.size() >= max_cache_size)
+      cache.clear();
+    cache.emplace(key, optp);
+    return true;
+  }
+
   double min_m = std::numeric_limits<double>::infinity();
   double min_k = 0.0;
   double curr_m = 0.0;
@@ -46,8 +87,6 @@ bloom_parameters::compute_optimal_parameters()
     k += 1.0;
   }
 
-  optimal_parameters_t& optp = optimal_parameters;
-
   optp.number_of_hashes = static_cast<unsigned int>(min_k);
   optp.table_size = static_cast<unsigned int>(min_m);
   optp.table_size += (((optp.table_size % bits_per_char) != 0) ? (bits_per_char - (optp.table_size % bits_per_char)) : 0);
@@ -62,14 +101,169 @@ bloom_parameters::compute_optimal_parameters()
   else if (optp.table_size > maximum_size)
      optp.table_size = maximum_size;
 
+  if (type == bloom_filter_blocked)
+  {
+    const unsigned int block_bits = bloom_block_size * bits_per_char;
+    optp.table_size = ((optp.table_size + block_bits - 1) / block_bits) * block_bits;
+  }
+
+  if (cache.size() >= max_cache_size)
+    cache.clear();
+  cache.emplace(key, optp);
+
+  return true;
+}
+
+static const uint64_t max_false_positive_exponent = 9;
+
+static double
+false_positive_scale(uint64_t exponent)
+{
+  // whole powers of ten up to 10^12 are exact doubles
+  double scale = 1000.;
+  for (uint64_t i = 0; i < exponent; ++i)
+    scale *= 10;
+  return scale;
+}
+
+uint64_t
+encode_false_positive(double false_positive_probability, bloom_filter_type type)
+{
+  // Whole thousandths keep the original encoding, smaller or finer rates
+  // take as many more decimal digits as they need, up to four significant ones
+  uint64_t exponent = 0;
+  double scaled = false_positive_probability * false_positive_scale(0);
+  while (exponent < max_false_positive_exponent && scaled < 1000 &&
+         std::fabs(scaled - std::round(scaled)) > 1e-9 * scaled)
+  {
+    ++exponent;
+    scaled = false_positive_probability * false_positive_scale(exponent);
+  }
+
+  return static_cast<uint64_t>(std::llround(scaled)) +
+         (static_cast<uint64_t>(type) << 16) +
+         (exponent << 24);
+}
+
+bool
+decode_false_positive(uint64_t value, bloom_parameters& p)
+{
+  uint64_t type = (value >> 16) & 0xFF;
+  uint64_t exponent = value >> 24;
+  if (type > bloom_filter_cuckoo || exponent > max_false_positive_exponent)
+    return false;
+
+  p.type = static_cast<bloom_filter_type>(type);
+  p.false_positive_probability = (value & 0xFFFF) / false_positive_scale(exponent);
   return true;
 }
 
+void
+compress_bloom_table(const uint8_t* table, std::size_t size, std::vector <uint8_t>& out)
+{
+  std::size_t set_bits = 0;
+  for (std::size_t i = 0; i < size; ++i)
+    set_bits += std::bitset<bits_per_char>(table[i]).count();
+
+  // Gaps are close to geometric with mean size * 8 / set_bits, Rice coding
+  // them is near optimal for 2^k about ln(2) times the mean
+  unsigned int k = 0;
+  double mean_gap = set_bits == 0 ? 1.0 : double(size * bits_per_char) / set_bits;
+  while (k < 31 && double(std::size_t(2) << k) <= mean_gap * 0.6931)
+    ++k;
+
+  out.clear();
+  out.push_back(static_cast<uint8_t>(k));
+
+  uint8_t current = 0;
+  unsigned int used = 0;
+  auto put_bit = [&] (unsigned int bit)
+  {
+    current = static_cast<uint8_t>((current << 1) | bit);
+    if (++used == bits_per_char)
+    {
+      out.push_back(current);
+      current = 0;
+      used = 0;
+    }
+  };
+
+  std::size_t previous = 0;
+  for (std::size_t i = 0; i < size * bits_per_char; ++i)
+  {
+    if ((table[i / bits_per_char] & bit_mask[i % bits_per_char]) == 0)
+      continue;
+
+    // from bit -1, so that a gap is never negative
+    std::size_t gap = i + 1 - previous;
+    previous = i + 1;
+    for (std::size_t q = gap >> k; q > 0; --q)
+      put_bit(1);
+    put_bit(0);
+    for (unsigned int b = k; b-- > 0;)
+      put_bit((gap >> b) & 1);
+  }
+
+  while (used != 0)
+    put_bit(1);
+}
+
+bool
+decompress_bloom_table(const uint8_t* data, std::size_t data_size,
+                       uint8_t* table, std::size_t size)
+{
+  if (data_size == 0 || data[0] > 31)
+    return false;
+
+  const unsigned int k = data[0];
+  const std::size_t end = data_size * bits_per_char;
+  const std::size_t table_bits = size * bits_per_char;
+  std::size_t position = bits_per_char;
+  auto get_bit = [&] () -> std::size_t
+  {
+    std::size_t bit = (data[position / bits_per_char] >> (7 - position % bits_per_char)) & 1;
+    ++position;
+    return bit;
+  };
+
+  std::fill(table, table + size, 0);
+  std::size_t previous = 0;
+  while (true)
+  {
+    std::size_t q = 0;
+    bool is_end = true;
+    while (position < end)
+    {
+      if (get_bit() == 0)
+      {
+        is_end = false;
+        break;
+      }
+      ++q;
+    }
+    // only the ones padding the last byte are left
+    if (is_end)
+      return q < bits_per_char;
+    if (position + k > end)
+      return false;
+
+    std::size_t gap = q << k;
+    for (unsigned int b = k; b-- > 0;)
+      gap |= get_bit() << b;
+
+    if (gap == 0 || gap > table_bits - previous)
+      return false;
+    previous += gap;
+    table[(previous - 1) / bits_per_char] |= bit_mask[(previous - 1) % bits_per_char];
+  }
+}
+
 /*************************************************************************/
 /* bloom-filter */
 
 bloom_filter::bloom_filter()
 : bit_table_(0)
+, table_view_(nullptr)
 , salt_count_(0)
 , table_size_(0)
 , raw_table_size_(0)
@@ -77,39 +271,143 @@ bloom_filter::bloom_filter()
 , inserted_element_count_(0)
 , random_seed_(0)
 , desired_false_positive_probability_(0.0)
+, type_(bloom_filter_salted)
+, block_count_(0)
 {}
 
 bloom_filter::bloom_filter(const bloom_parameters& p)
 : bit_table_(0)
+, table_view_(nullptr)
 , projected_element_count_(p.projected_element_count)
 , inserted_element_count_(0)
 , random_seed_((p.random_seed * 0xA5A5A5A5) + 1)
 , desired_false_positive_probability_(p.false_positive_probability)
+, type_(p.type)
 {
   salt_count_ = p.optimal_parameters.number_of_hashes;
   table_size_ = p.optimal_parameters.table_size;
   generate_unique_salt();
   raw_table_size_ = table_size_ / bits_per_char;
+  block_count_ = raw_table_size_ / bloom_block_size;
   //bit_table_ = new cell_type[static_cast<std::size_t>(raw_table_size_)];
   bit_table_.resize(static_cast<std::size_t>(raw_table_size_), 0x00);
 }
 
+bloom_filter::bloom_filter(const bloom_parameters& p, const uint8_t* table, std::size_t size)
+: bit_table_(0)
+, table_view_(table)
+, projected_element_count_(p.projected_element_count)
+, inserted_element_count_(0)
+, random_seed_((p.random_seed * 0xA5A5A5A5) + 1)
+, desired_false_positive_probability_(p.false_positive_probability)
+, type_(p.type)
+{
+  salt_count_ = p.optimal_parameters.number_of_hashes;
+  table_size_ = p.optimal_parameters.table_size;
+  generate_unique_salt();
+  raw_table_size_ = table_size_ / bits_per_char;
+  block_count_ = raw_table_size_ / bloom_block_size;
+  assert(size == raw_table_size_);
+}
+
+bloom_filter::bloom_filter(const bloom_filter& other)
+: bloom_filter()
+{
+  *this = other;
+}
+
+bloom_filter&
+bloom_filter::operator=(const bloom_filter& other)
+{
+  if (this == &other)
+    return *this;
+
+  salt_ = other.salt_;
+  if (other.table_view_ != nullptr)
+    bit_table_.assign(other.table_view_, other.table_view_ + other.raw_table_size_);
+  else
+    bit_table_ = other.bit_table_;
+  table_view_ = nullptr;
+  salt_count_ = other.salt_count_;
+  table_size_ = other.table_size_;
+  raw_table_size_ = other.raw_table_size_;
+  projected_element_count_ = other.projected_element_count_;
+  inserted_element_count_ = other.inserted_element_count_;
+  random_seed_ = other.random_seed_;
+  desired_false_positive_probability_ = other.desired_false_positive_probability_;
+  type_ = other.type_;
+  block_count_ = other.block_count_;
+  return *this;
+}
+
+void
+bloom_filter::own_table()
+{
+  if (table_view_ != nullptr)
+  {
+    bit_table_.assign(table_view_, table_view_ + raw_table_size_);
+    table_view_ = nullptr;
+  }
+}
+
 void
 bloom_filter::clear()
 {
-  bit_table_.resize(static_cast<std::size_t>(raw_table_size_), 0x00);
+  bit_table_.assign(static_cast<std::size_t>(raw_table_size_), 0x00);
+  table_view_ = nullptr;
   inserted_element_count_ = 0;
 }
 
+static const uint8_t*
+key_bytes(const std::string& key)
+{
+  return reinterpret_cast<const uint8_t*>(key.data());
+}
+
 void
 bloom_filter::insert(const std::string& key)
 {
+  own_table();
+
   std::size_t bit_index = 0;
   std::size_t bit = 0;
-  for (std::size_t i = 0; i < salt_.size(); ++i)
+
+  switch (type_)
   {
-     compute_indices(MurmurHash3(salt_[i], ParseHex(key)), bit_index, bit);
-     bit_table_[bit_index/bits_per_char] |= bit_mask[bit];
+    case bloom_filter_blocked:
+    {
+      std::size_t block = 0;
+      uint8_t mask[bloom_block_size];
+      compute_block_mask(key, block, mask);
+      for (std::size_t i = 0; i < bloom_block_size; ++i)
+      {
+        bit_table_[block * bloom_block_size + i] |= mask[i];
+      }
+      break;
+    }
+    case bloom_filter_double_hashing:
+    {
+      bloom_type h1 = 0;
+      bloom_type h2 = 0;
+      compute_double_hashes(key, h1, h2);
+      for (std::size_t i = 0; i < salt_count_; ++i)
+      {
+        bit_index = (h1 + static_cast<uint64_t>(i) * h2) % table_size_;
+        bit_table_[bit_index/bits_per_char] |= bit_mask[bit_index % bits_per_char];
+      }
+      break;
+    }
+    case bloom_filter_cuckoo:
+      // a full table drops the key, use a cuckoo_filter to know about it
+      cuckoo_insert(bit_table_.data(), cuckoo_bucket_count(), salt_count_, key);
+      break;
+    case bloom_filter_salted:
+      for (std::size_t i = 0; i < salt_.size(); ++i)
+      {
+        compute_indices(MurmurHash3(salt_[i], key_bytes(key), key.size()), bit_index, bit);
+        bit_table_[bit_index/bits_per_char] |= bit_mask[bit];
+      }
+      break;
   }
   ++inserted_element_count_;
 }
@@ -117,22 +415,48 @@ bloom_filter::insert(const std::string& key)
 bool
 bloom_filter::contains(const std::string& key)
 {
-  // This was a hack for subscribe all
-  // A good implementation would have a human readable
-  // component instead of empty subscription list that would indicate full sync
-  // and never calls bloom filter
-  /*if (projected_element_count_== 1 && desired_false_positive_probability_ == 0.001) {
-    // subscribe all
-    return true;
-  }*/
+  // Consumers subscribed to everything send MARKER_SUBSCRIBE_ALL instead of
+  // a filter, producers never get here for them
 
+  const cell_type* table = bits();
   std::size_t bit_index = 0;
   std::size_t bit = 0;
 
+  switch (type_)
+  {
+    case bloom_filter_blocked:
+    {
+      std::size_t block = 0;
+      uint8_t mask[bloom_block_size];
+      compute_block_mask(key, block, mask);
+      return simd::containsAll(table + block * bloom_block_size, mask, bloom_block_size);
+    }
+    case bloom_filter_double_hashing:
+    {
+      bloom_type h1 = 0;
+      bloom_type h2 = 0;
+      compute_double_hashes(key, h1, h2);
+      for (std::size_t i = 0; i < salt_count_; ++i)
+      {
+        bit_index = (h1 + static_cast<uint64_t>(i) * h2) % table_size_;
+        bit = bit_index % bits_per_char;
+        if ((table[bit_index/bits_per_char] & bit_mask[bit]) != bit_mask[bit]) {
+          return false;
+        }
+      }
+      return true;
+    }
+    case bloom_filter_cuckoo:
+      return cuckoo_contains(table, cuckoo_bucket_count(), salt_count_, key);
+    case bloom_filter_salted:
+      break;
+  }
+
+  // The key bytes are hashed under each salt, but not copied
   for (std::size_t i = 0; i < salt_.size(); ++i)
   {
-    compute_indices(MurmurHash3(salt_[i], ParseHex(key)), bit_index, bit);
-    if ((bit_table_[bit_index/bits_per_char] & bit_mask[bit]) != bit_mask[bit]) {
+    compute_indices(MurmurHash3(salt_[i], key_bytes(key), key.size()), bit_index, bit);
+    if ((table[bit_index/bits_per_char] & bit_mask[bit]) != bit_mask[bit]) {
       return false;
     }
   }
@@ -143,7 +467,7 @@ bloom_filter::contains(const std::string& key)
 std::vector <bloom_filter::cell_type>
 bloom_filter::table()
 {
-  return bit_table_;
+  return std::vector<cell_type>(bits(), bits() + raw_table_size_);
 }
 
 void
@@ -151,6 +475,7 @@ bloom_filter::setTable(std::vector <bloom_filter::cell_type> table)
 {
   assert(table.size() == raw_table_size_);
   bit_table_ = table;
+  table_view_ = nullptr;
 }
 
 unsigned int
@@ -159,6 +484,65 @@ bloom_filter::getTableSize()
   return raw_table_size_;
 }
 
+void
+bloom_filter::compute_bit_indices(const std::string& key, std::size_t* indices)
+{
+  std::size_t bit = 0;
+
+  switch (type_)
+  {
+    case bloom_filter_blocked:
+    {
+      const std::size_t block_bits = bloom_block_size * bits_per_char;
+      std::size_t block = 0;
+      bloom_type first = 0;
+      bloom_type step = 0;
+      compute_block_hashes(key, block, first, step);
+      for (std::size_t i = 0; i < salt_count_; ++i)
+      {
+        indices[i] = block * block_bits + (first + i * step) % block_bits;
+      }
+      break;
+    }
+    case bloom_filter_double_hashing:
+    {
+      bloom_type h1 = 0;
+      bloom_type h2 = 0;
+      compute_double_hashes(key, h1, h2);
+      for (std::size_t i = 0; i < salt_count_; ++i)
+      {
+        indices[i] = (h1 + static_cast<uint64_t>(i) * h2) % table_size_;
+      }
+      break;
+    }
+    case bloom_filter_cuckoo:
+      // no bits to count, a cuckoo_filter removes keys itself
+      assert(false);
+      std::fill(indices, indices + salt_count_, 0);
+      break;
+    case bloom_filter_salted:
+      for (std::size_t i = 0; i < salt_.size(); ++i)
+      {
+        compute_indices(MurmurHash3(salt_[i], key_bytes(key), key.size()), indices[i], bit);
+      }
+      break;
+  }
+}
+
+void
+bloom_filter::set_bit(std::size_t bit_index)
+{
+  own_table();
+  bit_table_[bit_index / bits_per_char] |= bit_mask[bit_index % bits_per_char];
+}
+
+void
+bloom_filter::clear_bit(std::size_t bit_index)
+{
+  own_table();
+  bit_table_[bit_index / bits_per_char] &= ~bit_mask[bit_index % bits_per_char];
+}
+
 void
 bloom_filter::generate_unique_salt()
 {
@@ -232,4 +616,108 @@ bloom_filter::compute_indices(const bloom_type& hash, std::size_t& bit_index, st
   bit = bit_index % bits_per_char;
 }
 
-} // namespace psync
\ No newline at end of file
+void
+bloom_filter::compute_block_hashes(const std::string& key, std::size_t& block,
+                                   bloom_type& first, bloom_type& step)
+{
+  // One hash picks the block, a second one is stepped by double hashing to
+  // the salt_count_ bits inside it
+  bloom_type h1 = MurmurHash3(salt_[0], key_bytes(key), key.size());
+  first = MurmurHash3(salt_[salt_.size() - 1] ^ 0x9E3779B9, key_bytes(key), key.size());
+  step = (first >> 16) | 1;
+  block = h1 % block_count_;
+}
+
+void
+bloom_filter::compute_block_mask(const std::string& key, std::size_t& block,
+                                 uint8_t (&mask)[bloom_block_size])
+{
+  const std::size_t block_bits = bloom_block_size * bits_per_char;
+  bloom_type first = 0;
+  bloom_type step = 0;
+  compute_block_hashes(key, block, first, step);
+
+  std::fill(mask, mask + bloom_block_size, 0);
+  for (std::size_t i = 0; i < salt_count_; ++i)
+  {
+    std::size_t bit = (first + i * step) % block_bits;
+    mask[bit / bits_per_char] |= bit_mask[bit % bits_per_char];
+  }
+}
+
+void
+bloom_filter::compute_double_hashes(const std::string& key, bloom_type& h1, bloom_type& h2)
+{
+  // The key bytes are hashed once, the second hash only re-mixes the first.
+  // Odd, so that it steps through every index of a power of two table.
+  h1 = MurmurHash3(salt_[0], key_bytes(key), key.size());
+  h2 = MurmurHash3(salt_[0], h1) | 1;
+}
+
+std::size_t
+bloom_filter::cuckoo_bucket_count() const
+{
+  return table_size_ / (cuckoo_bucket_size * salt_count_);
+}
+
+/*************************************************************************/
+/* counting-bloom-filter */
+
+counting_bloom_filter::counting_bloom_filter()
+{}
+
+counting_bloom_filter::counting_bloom_filter(const bloom_parameters& p)
+: bloom_filter(p)
+, counters_(bit_count(), 0)
+, indices_(hash_count())
+{
+  // see cuckoo_filter
+  assert(p.type != bloom_filter_cuckoo);
+}
+
+void
+counting_bloom_filter::clear()
+{
+  bloom_filter::clear();
+  std::fill(counters_.begin(), counters_.end(), 0);
+}
+
+void
+counting_bloom_filter::insert(const std::string& key)
+{
+  compute_bit_indices(key, indices_.data());
+  for (std::size_t bit_index : indices_)
+  {
+    if (counters_[bit_index] == 0)
+      set_bit(bit_index);
+    if (counters_[bit_index] != max_count)
+      ++counters_[bit_index];
+  }
+  set_element_count(element_count() + 1);
+}
+
+bool
+counting_bloom_filter::remove(const std::string& key)
+{
+  compute_bit_indices(key, indices_.data());
+  for (std::size_t bit_index : indices_)
+  {
+    if (counters_[bit_index] == 0)
+      return false;
+  }
+
+  // An index coming up twice was counted twice by insert, and is taken
+  // down twice here
+  for (std::size_t bit_index : indices_)
+  {
+    if (counters_[bit_index] == 0 || counters_[bit_index] == max_count)
+      continue;
+    if (--counters_[bit_index] == 0)
+      clear_bit(bit_index);
+  }
+  if (element_count() != 0)
+    set_element_count(element_count() - 1);
+  return true;
+}
+
+} // namespace psync
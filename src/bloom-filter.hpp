@@ -1,6 +1,7 @@
 #ifndef PSYNC_BLOOM_FILTER_HPP
 #define PSYNC_BLOOM_FILTER_HPP
 
+#include <inttypes.h>
 #include <string>
 #include <vector>
 
@@ -18,6 +19,30 @@ static const unsigned char bit_mask[bits_per_char] = {
                                0x80   //10000000
                              };
 
+/* A blocked Bloom filter keeps all the bits of a key in one block of this
+ * many bytes (a cache line), so a lookup touches one cache line and tests
+ * all of them at once with simd::containsAll.
+ */
+static const std::size_t bloom_block_size = 64;
+
+/* How a filter maps a key to its bits. The type is sent along with the
+ * filter in a sync interest, see encode_false_positive, so that the producer
+ * reads the table the way the consumer wrote it.
+ */
+enum bloom_filter_type
+{
+  // salt_count_ MurmurHash3 of the key under different salts, the original filter
+  bloom_filter_salted = 0,
+  // all the bits of a key in one bloom_block_size block
+  bloom_filter_blocked = 1,
+  // one MurmurHash3 of the key, the salt_count_ indices derived from it by
+  // Kirsch-Mitzenmacher double hashing (h1 + i * h2)
+  bloom_filter_double_hashing = 2,
+  // not a Bloom filter but the table of a cuckoo_filter (cuckoo-filter.hpp),
+  // which can only be read and inserted into as a bloom_filter
+  bloom_filter_cuckoo = 3
+};
+
 struct optimal_parameters_t
 {
   optimal_parameters_t()
@@ -44,9 +69,47 @@ public:
   unsigned int           projected_element_count;
   double                 false_positive_probability;
   unsigned long long int random_seed;
+  // a blocked filter rounds the table size up to whole blocks, a cuckoo
+  // filter puts its fingerprint size in number_of_hashes
+  bloom_filter_type      type;
   optimal_parameters_t   optimal_parameters;
 };
 
+/* The false positive component of a sync interest: the probability times
+ * 1000 * 10^e (below 0x10000), plus the filter type shifted left by 16 bits,
+ * plus e (at most 9) shifted left by 24 bits. Filters from before the type
+ * was sent are salted and read as such. Rates in whole thousandths have e = 0,
+ * as before e was sent; smaller ones, where a cuckoo filter is smaller than a
+ * Bloom filter, take the e they need. Peers that do not know e refuse them.
+ */
+uint64_t
+encode_false_positive(double false_positive_probability, bloom_filter_type type);
+
+/**
+ * @brief Set the probability and type of @p p from a false positive component
+ * @return false if the type or the exponent is unknown
+ */
+bool
+decode_false_positive(uint64_t value, bloom_parameters& p);
+
+/* A sparse table can be sent compressed: one byte holding the Rice
+ * parameter k, then the gaps between set bits (from bit -1 on), each as the
+ * gap >> k in unary (ones ended by a zero) and its k low bits, most
+ * significant bit first, the last byte padded with ones. A sync interest
+ * carries whichever is smaller, the bloom filter size component keeps the
+ * size of the raw table, so a shorter component is compressed.
+ */
+void
+compress_bloom_table(const uint8_t* table, std::size_t size, std::vector <uint8_t>& out);
+
+/**
+ * @brief Decode compress_bloom_table output into the @p size bytes at @p table
+ * @return false if the input is malformed or sets a bit past the table
+ */
+bool
+decompress_bloom_table(const uint8_t* data, std::size_t data_size,
+                       uint8_t* table, std::size_t size);
+
 class bloom_filter
 {
 protected:
@@ -57,25 +120,68 @@ protected:
 public:
   bloom_filter();
   bloom_filter(const bloom_parameters& p);
+
+  /**
+   * @brief Read-only filter over the @p size bytes at @p table, e.g. the Bloom
+   *        filter component of a sync interest, which must outlive it
+   *
+   * Nothing is copied until the filter is inserted into or copied, copies
+   * own their bytes. @p size must be the table size of @p p.
+   */
+  bloom_filter(const bloom_parameters& p, const uint8_t* table, std::size_t size);
+
+  bloom_filter(const bloom_filter& other);
+  bloom_filter& operator=(const bloom_filter& other);
+  // a moved read-only filter stays read-only
+  bloom_filter(bloom_filter&& other) = default;
+  bloom_filter& operator=(bloom_filter&& other) = default;
+
   virtual ~bloom_filter()
   {}
 
-  void clear();
-  void insert(const std::string& key);
+  // virtual so that a counting_bloom_filter used as a bloom_filter keeps its
+  // counters in step
+  virtual void clear();
+  virtual void insert(const std::string& key);
   bool contains(const std::string& key);
+  unsigned int element_count() const { return inserted_element_count_; }
   std::vector <cell_type> table();
   void setTable(std::vector <cell_type> table);
   unsigned int getTableSize();
-  Iterator begin() { return bit_table_.begin(); }
-  Iterator end()   { return bit_table_.end();   }
+  Iterator begin() { own_table(); return bit_table_.begin(); }
+  Iterator end()   { own_table(); return bit_table_.end();   }
+
+protected:
+  // the salt_count_ bit indices of a key in the table, whatever the type,
+  // the same index may come up more than once
+  void compute_bit_indices(const std::string& key, std::size_t* indices);
+  void set_bit(std::size_t bit_index);
+  void clear_bit(std::size_t bit_index);
+  unsigned int hash_count() const { return salt_count_; }
+  unsigned int bit_count() const { return table_size_; }
+  void set_element_count(unsigned int count) { inserted_element_count_ = count; }
 
 private:
+  // copy the bytes of a read-only filter into bit_table_
+  void own_table();
+  const cell_type* bits() const { return table_view_ != nullptr ? table_view_ : bit_table_.data(); }
   void generate_unique_salt();
   void compute_indices(const bloom_type& hash, std::size_t& bit_index, std::size_t& bit);
+  // block of a key, and the first bit and step of its bits within the block
+  void compute_block_hashes(const std::string& key, std::size_t& block,
+                            bloom_type& first, bloom_type& step);
+  // block of a key and the mask of its bits within the block
+  void compute_block_mask(const std::string& key, std::size_t& block,
+                          uint8_t (&mask)[bloom_block_size]);
+  void compute_double_hashes(const std::string& key, bloom_type& h1, bloom_type& h2);
+  // salt_count_ is the fingerprint size of a bloom_filter_cuckoo table
+  std::size_t cuckoo_bucket_count() const;
 
 private:
   std::vector <bloom_type> salt_;
   std::vector <cell_type>             bit_table_;
+  // bytes of a read-only filter, bit_table_ is then empty
+  const cell_type*        table_view_;
   unsigned int            salt_count_;
   unsigned int            table_size_; // 8 * raw_table_size;
   unsigned int            raw_table_size_;
@@ -83,6 +189,38 @@ private:
   unsigned int            inserted_element_count_;
   unsigned long long int  random_seed_;
   double                  desired_false_positive_probability_;
+  bloom_filter_type       type_;
+  unsigned int            block_count_;
+};
+
+/* A bloom_filter that also counts, for every bit, the keys setting it, so
+ * that a key can be removed again. Only the bits go on the wire: begin(),
+ * end() and table() are those of the plain filter with the same keys.
+ */
+class counting_bloom_filter : public bloom_filter
+{
+public:
+  counting_bloom_filter();
+  counting_bloom_filter(const bloom_parameters& p);
+
+  void clear() override;
+  void insert(const std::string& key) override;
+
+  /**
+   * @brief Remove a key inserted before
+   * @return false, leaving the filter as it was, if the key is not in it
+   *
+   * Removing a key that was never inserted but is a false positive takes
+   * out other keys with it, callers should only remove what they inserted.
+   */
+  bool remove(const std::string& key);
+
+private:
+  // a counter stuck at the maximum stays there, its bit is never cleared
+  static const uint8_t max_count = 0xFF;
+
+  std::vector <uint8_t>     counters_;
+  std::vector <std::size_t> indices_;
 };
 
 } // namespace psync
@@ -0,0 +1,243 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2018,  The University of Memphis
+ *
+ * This file is part of NLSR (Named-data Link State Routing).
+ * See AUTHORS.md for complete list of NLSR authors and contributors.
+ *
+ * NLSR is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NLSR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NLSR, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include "cuckoo-filter.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+// Fan et al., "Cuckoo Filter: Practically Better Than Bloom", CoNEXT 2014
+
+namespace psync {
+
+// the salt of the key hash, the fingerprint and the alternate bucket
+static const uint32_t cuckoo_seed = 0xB5B5B5B5;
+
+// With four slots per bucket, inserts start failing now and then above
+// this load in small tables, see cuckoo_filter::insert
+static const double cuckoo_max_load = 0.9;
+
+void
+cuckoo_compute_parameters(unsigned int count, double false_positive_probability,
+                          unsigned int& fingerprint_bits, std::size_t& bucket_count)
+{
+  // A lookup compares against the 2 * cuckoo_bucket_size fingerprints of two
+  // buckets, each matching with probability 2^-fingerprint_bits
+  if (false_positive_probability <= 0) {
+    fingerprint_bits = 32;
+  }
+  else {
+    double bits = std::ceil(std::log2(2 * cuckoo_bucket_size / false_positive_probability));
+    fingerprint_bits = static_cast<unsigned int>(std::min(32.0, std::max(4.0, bits)));
+  }
+
+  bucket_count = static_cast<std::size_t>(std::ceil(count / (cuckoo_bucket_size * cuckoo_max_load)));
+  bucket_count = std::max<std::size_t>(bucket_count, 1);
+}
+
+static uint32_t
+fingerprint_mask(unsigned int fingerprint_bits)
+{
+  return static_cast<uint32_t>((uint64_t(1) << fingerprint_bits) - 1);
+}
+
+static uint32_t
+get_slot(const uint8_t* table, std::size_t slot, unsigned int fingerprint_bits)
+{
+  // at most 32 bits starting anywhere in a byte, so at most 5 bytes
+  std::size_t offset = slot * fingerprint_bits;
+  std::size_t first = offset / bits_per_char;
+  std::size_t last = (offset + fingerprint_bits - 1) / bits_per_char;
+  uint64_t value = 0;
+  for (std::size_t i = last + 1; i-- > first;) {
+    value = (value << 8) | table[i];
+  }
+  return static_cast<uint32_t>(value >> (offset % bits_per_char)) & fingerprint_mask(fingerprint_bits);
+}
+
+static void
+set_slot(uint8_t* table, std::size_t slot, unsigned int fingerprint_bits, uint32_t fingerprint)
+{
+  std::size_t offset = slot * fingerprint_bits;
+  std::size_t first = offset / bits_per_char;
+  std::size_t last = (offset + fingerprint_bits - 1) / bits_per_char;
+  std::size_t shift = offset % bits_per_char;
+  uint64_t value = 0;
+  for (std::size_t i = last + 1; i-- > first;) {
+    value = (value << 8) | table[i];
+  }
+  value &= ~(uint64_t(fingerprint_mask(fingerprint_bits)) << shift);
+  value |= uint64_t(fingerprint) << shift;
+  for (std::size_t i = first; i <= last; ++i) {
+    table[i] = static_cast<uint8_t>(value);
+    value >>= 8;
+  }
+}
+
+// the slot of @p fingerprint in @p bucket, or cuckoo_bucket_size
+static std::size_t
+find_in_bucket(const uint8_t* table, std::size_t bucket, unsigned int fingerprint_bits,
+               uint32_t fingerprint)
+{
+  for (std::size_t i = 0; i < cuckoo_bucket_size; ++i) {
+    if (get_slot(table, bucket * cuckoo_bucket_size + i, fingerprint_bits) == fingerprint) {
+      return i;
+    }
+  }
+  return cuckoo_bucket_size;
+}
+
+static void
+compute_bucket_and_fingerprint(const std::string& key, std::size_t bucket_count,
+                               unsigned int fingerprint_bits, std::size_t& bucket,
+                               uint32_t& fingerprint)
+{
+  uint32_t hash = MurmurHash3(cuckoo_seed, reinterpret_cast<const uint8_t*>(key.data()),
+                              key.size());
+  bucket = hash % bucket_count;
+  fingerprint = MurmurHash3(cuckoo_seed, hash) & fingerprint_mask(fingerprint_bits);
+  if (fingerprint == 0) {
+    fingerprint = 1;
+  }
+}
+
+static std::size_t
+alternate_bucket(std::size_t bucket, std::size_t bucket_count, uint32_t fingerprint)
+{
+  // (h(f) - i) mod m is its own inverse for any m, so the table does not
+  // need a power of two number of buckets as with the usual i ^ h(f)
+  std::size_t h = MurmurHash3(cuckoo_seed, fingerprint) % bucket_count;
+  return (h + bucket_count - bucket) % bucket_count;
+}
+
+bool
+cuckoo_contains(const uint8_t* table, std::size_t bucket_count, unsigned int fingerprint_bits,
+                const std::string& key)
+{
+  std::size_t bucket = 0;
+  uint32_t fingerprint = 0;
+  compute_bucket_and_fingerprint(key, bucket_count, fingerprint_bits, bucket, fingerprint);
+
+  return find_in_bucket(table, bucket, fingerprint_bits, fingerprint) != cuckoo_bucket_size ||
+         find_in_bucket(table, alternate_bucket(bucket, bucket_count, fingerprint),
+                        fingerprint_bits, fingerprint) != cuckoo_bucket_size;
+}
+
+bool
+cuckoo_insert(uint8_t* table, std::size_t bucket_count, unsigned int fingerprint_bits,
+              const std::string& key)
+{
+  std::size_t bucket = 0;
+  uint32_t fingerprint = 0;
+  compute_bucket_and_fingerprint(key, bucket_count, fingerprint_bits, bucket, fingerprint);
+
+  for (std::size_t b : {bucket, alternate_bucket(bucket, bucket_count, fingerprint)}) {
+    std::size_t slot = find_in_bucket(table, b, fingerprint_bits, 0);
+    if (slot != cuckoo_bucket_size) {
+      set_slot(table, b * cuckoo_bucket_size + slot, fingerprint_bits, fingerprint);
+      return true;
+    }
+  }
+
+  // Both buckets are full: move a random fingerprint to its other bucket,
+  // and so on. The moves are kept to be undone if no free slot turns up.
+  std::vector<std::size_t> path;
+  path.reserve(cuckoo_max_kicks);
+  uint32_t random = fingerprint;
+  for (std::size_t kick = 0; kick < cuckoo_max_kicks; ++kick) {
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    std::size_t slot = bucket * cuckoo_bucket_size + random % cuckoo_bucket_size;
+    uint32_t victim = get_slot(table, slot, fingerprint_bits);
+    set_slot(table, slot, fingerprint_bits, fingerprint);
+    path.push_back(slot);
+
+    fingerprint = victim;
+    bucket = alternate_bucket(bucket, bucket_count, fingerprint);
+    std::size_t free_slot = find_in_bucket(table, bucket, fingerprint_bits, 0);
+    if (free_slot != cuckoo_bucket_size) {
+      set_slot(table, bucket * cuckoo_bucket_size + free_slot, fingerprint_bits, fingerprint);
+      return true;
+    }
+  }
+
+  for (auto slot = path.rbegin(); slot != path.rend(); ++slot) {
+    uint32_t moved = get_slot(table, *slot, fingerprint_bits);
+    set_slot(table, *slot, fingerprint_bits, fingerprint);
+    fingerprint = moved;
+  }
+  return false;
+}
+
+bool
+cuckoo_remove(uint8_t* table, std::size_t bucket_count, unsigned int fingerprint_bits,
+              const std::string& key)
+{
+  std::size_t bucket = 0;
+  uint32_t fingerprint = 0;
+  compute_bucket_and_fingerprint(key, bucket_count, fingerprint_bits, bucket, fingerprint);
+
+  for (std::size_t b : {bucket, alternate_bucket(bucket, bucket_count, fingerprint)}) {
+    std::size_t slot = find_in_bucket(table, b, fingerprint_bits, fingerprint);
+    if (slot != cuckoo_bucket_size) {
+      set_slot(table, b * cuckoo_bucket_size + slot, fingerprint_bits, 0);
+      return true;
+    }
+  }
+  return false;
+}
+
+/*************************************************************************/
+/* cuckoo-filter */
+
+cuckoo_filter::cuckoo_filter()
+: bucket_count_(0)
+, fingerprint_bits_(0)
+{}
+
+cuckoo_filter::cuckoo_filter(const bloom_parameters& p)
+: table_(p.optimal_parameters.table_size / bits_per_char, 0)
+, fingerprint_bits_(p.optimal_parameters.number_of_hashes)
+{
+  assert(p.type == bloom_filter_cuckoo);
+  bucket_count_ = p.optimal_parameters.table_size / (cuckoo_bucket_size * fingerprint_bits_);
+}
+
+bool
+cuckoo_filter::insert(const std::string& key)
+{
+  return cuckoo_insert(table_.data(), bucket_count_, fingerprint_bits_, key);
+}
+
+bool
+cuckoo_filter::remove(const std::string& key)
+{
+  return cuckoo_remove(table_.data(), bucket_count_, fingerprint_bits_, key);
+}
+
+bool
+cuckoo_filter::contains(const std::string& key) const
+{
+  return cuckoo_contains(table_.data(), bucket_count_, fingerprint_bits_, key);
+}
+
+} // namespace psync
@@ -0,0 +1,113 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2018,  The University of Memphis
+ *
+ * This file is part of NLSR (Named-data Link State Routing).
+ * See AUTHORS.md for complete list of NLSR authors and contributors.
+ *
+ * NLSR is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NLSR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NLSR, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef PSYNC_CUCKOO_FILTER_HPP
+#define PSYNC_CUCKOO_FILTER_HPP
+
+#include "bloom-filter.hpp"
+
+#include <inttypes.h>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace psync {
+
+/* A cuckoo filter table is bucket_count buckets of cuckoo_bucket_size
+ * fingerprints of fingerprint_bits bits each, packed back to back in
+ * little-endian bit order. A key can only be in its two buckets, so a
+ * lookup reads at most two of them. Zero marks a free slot.
+ */
+static const std::size_t cuckoo_bucket_size = 4;
+
+// relocations tried before an insert gives up
+static const std::size_t cuckoo_max_kicks = 500;
+
+/**
+ * @brief Fingerprint bits and bucket count of a cuckoo filter with a
+ *        false positive probability of at most @p false_positive_probability
+ *        for @p count keys
+ *
+ * Filled the same way by bloom_parameters::compute_optimal_parameters for
+ * the bloom_filter_cuckoo type: number_of_hashes is the fingerprint size
+ * and table_size the size of the packed table, in bits.
+ */
+void
+cuckoo_compute_parameters(unsigned int count, double false_positive_probability,
+                          unsigned int& fingerprint_bits, std::size_t& bucket_count);
+
+bool
+cuckoo_contains(const uint8_t* table, std::size_t bucket_count, unsigned int fingerprint_bits,
+                const std::string& key);
+
+/**
+ * @return false, leaving @p table as it was, if no slot could be freed for
+ *         the key
+ */
+bool
+cuckoo_insert(uint8_t* table, std::size_t bucket_count, unsigned int fingerprint_bits,
+              const std::string& key);
+
+/**
+ * @brief Remove one copy of the fingerprint of @p key
+ * @return false if it is not in the table
+ */
+bool
+cuckoo_remove(uint8_t* table, std::size_t bucket_count, unsigned int fingerprint_bits,
+              const std::string& key);
+
+/* Cuckoo filter of subscriptions, the consumer side of the
+ * bloom_filter_cuckoo type: its table goes in the Bloom filter component of
+ * a sync interest, and a producer reads it with a bloom_filter of that type.
+ * Unlike a Bloom filter it can be full, see insert.
+ */
+class cuckoo_filter
+{
+public:
+  cuckoo_filter();
+
+  // p.type must be bloom_filter_cuckoo, with optimal_parameters computed
+  cuckoo_filter(const bloom_parameters& p);
+
+  /**
+   * @return false if the filter is full, it must then be rebuilt for more keys
+   */
+  bool insert(const std::string& key);
+
+  /**
+   * @return false if the key is not in the filter
+   *
+   * As with counting_bloom_filter, only remove keys that were inserted.
+   */
+  bool remove(const std::string& key);
+
+  bool contains(const std::string& key) const;
+
+  const std::vector <uint8_t>& table() const { return table_; }
+  unsigned int getTableSize() const { return table_.size(); }
+
+private:
+  std::vector <uint8_t> table_;
+  std::size_t           bucket_count_;
+  unsigned int          fingerprint_bits_;
+};
+
+} // namespace psync
+
+#endif // PSYNC_CUCKOO_FILTER_HPP
@@ -0,0 +1,157 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2018,  The University of Memphis
+ *
+ * This file is part of NLSR (Named-data Link State Routing).
+ * See AUTHORS.md for complete list of NLSR authors and contributors.
+ *
+ * NLSR is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NLSR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NLSR, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include "difference-estimator.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+namespace psync {
+
+const size_t DifferenceEstimator::SKETCH_SIZE;
+
+DifferenceEstimator::DifferenceEstimator()
+  : m_numElements(0)
+{
+}
+
+void
+DifferenceEstimator::insert(uint32_t hash)
+{
+  // Once hashes have been dropped we only know that every unseen hash is
+  // larger than the ones we keep, so a larger hash cannot be placed
+  bool isComplete = m_bottom.size() == m_numElements;
+  ++m_numElements;
+
+  if (m_bottom.size() < 2 * SKETCH_SIZE) {
+    if (isComplete || (!m_bottom.empty() && hash < *m_bottom.rbegin())) {
+      m_bottom.insert(hash);
+    }
+  }
+  else if (hash < *m_bottom.rbegin()) {
+    m_bottom.insert(hash);
+    m_bottom.erase(std::prev(m_bottom.end()));
+  }
+}
+
+void
+DifferenceEstimator::erase(uint32_t hash)
+{
+  if (m_numElements == 0) {
+    return;
+  }
+  --m_numElements;
+  m_bottom.erase(hash);
+}
+
+void
+DifferenceEstimator::clear()
+{
+  m_numElements = 0;
+  m_bottom.clear();
+}
+
+void
+DifferenceEstimator::appendToName(ndn::Name& name) const
+{
+  size_t nHashes = std::min(SKETCH_SIZE, m_bottom.size());
+  std::vector<uint8_t> buffer(5 + 4 * nHashes);
+
+  buffer[0] = MARKER_ESTIMATOR;
+  uint32_t numElements = static_cast<uint32_t>(m_numElements);
+  for (size_t b = 0; b < 4; ++b) {
+    buffer[1 + b] = static_cast<uint8_t>(numElements >> (8 * b));
+  }
+
+  uint8_t* out = buffer.data() + 5;
+  auto it = m_bottom.begin();
+  for (size_t i = 0; i < nHashes; ++i, ++it) {
+    for (size_t b = 0; b < 4; ++b) {
+      *out++ = static_cast<uint8_t>(*it >> (8 * b));
+    }
+  }
+
+  name.append(buffer.begin(), buffer.end());
+}
+
+size_t
+DifferenceEstimator::estimateDifference(const ndn::name::Component& component) const
+{
+  if (!isEstimatorComponent(component) || (component.value_size() - 5) % 4 != 0) {
+    throw std::invalid_argument("Malformed difference estimator");
+  }
+
+  const uint8_t* in = component.value();
+  uint32_t otherNumElements = 0;
+  for (size_t b = 0; b < 4; ++b) {
+    otherNumElements |= static_cast<uint32_t>(in[1 + b]) << (8 * b);
+  }
+
+  size_t nOther = (component.value_size() - 5) / 4;
+  std::vector<uint32_t> other(nOther);
+  in += 5;
+  for (size_t i = 0; i < nOther; ++i, in += 4) {
+    other[i] = in[0] | (in[1] << 8) | (in[2] << 16) | (static_cast<uint32_t>(in[3]) << 24);
+  }
+
+  // Walk the k smallest hashes of the union: each one that appears in both
+  // sketches is in the intersection, because a sketch holds all hashes of its
+  // set that are smaller than its largest kept hash
+  auto ours = m_bottom.begin();
+  auto oursEnd = m_bottom.begin();
+  std::advance(oursEnd, std::min(SKETCH_SIZE, m_bottom.size()));
+  auto theirs = other.begin();
+
+  size_t nUnion = 0;
+  size_t nCommon = 0;
+  while (nUnion < SKETCH_SIZE && (ours != oursEnd || theirs != other.end())) {
+    if (theirs == other.end() || (ours != oursEnd && *ours < *theirs)) {
+      ++ours;
+    }
+    else if (ours == oursEnd || *theirs < *ours) {
+      ++theirs;
+    }
+    else {
+      ++ours;
+      ++theirs;
+      ++nCommon;
+    }
+    ++nUnion;
+  }
+
+  if (nUnion == 0) {
+    return 0;
+  }
+
+  double jaccard = static_cast<double>(nCommon) / nUnion;
+  double total = static_cast<double>(m_numElements) + otherNumElements;
+  return static_cast<size_t>(std::lround(total * (1 - jaccard) / (1 + jaccard)));
+}
+
+bool
+DifferenceEstimator::isEstimatorComponent(const ndn::name::Component& component)
+{
+  return component.value_size() >= 5 && component.value()[0] == MARKER_ESTIMATOR;
+}
+
+} // namespace psync
@@ -0,0 +1,104 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2018,  The University of Memphis
+ *
+ * This file is part of NLSR (Named-data Link State Routing).
+ * See AUTHORS.md for complete list of NLSR authors and contributors.
+ *
+ * NLSR is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NLSR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NLSR, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef PSYNC_DIFFERENCE_ESTIMATOR_HPP
+#define PSYNC_DIFFERENCE_ESTIMATOR_HPP
+
+#include <inttypes.h>
+#include <cstddef>
+#include <set>
+
+#include <ndn-cxx/name.hpp>
+
+namespace psync {
+
+/**
+ * @brief Min-wise (bottom-k) sketch of the set of hashes inserted into the IBLT
+ *
+ * The sketch keeps the smallest hashes of the set together with the set size.
+ * Comparing the sketches of two peers gives an estimate of the Jaccard
+ * similarity J of their sets and from it the size of the symmetric difference,
+ * (nA + nB)(1 - J)/(1 + J). The estimate is exact while both sets hold no more
+ * than SKETCH_SIZE elements.
+ *
+ * Up to 2*SKETCH_SIZE hashes are kept so that erasing does not immediately
+ * deplete the sketch. needsRebuild() tells the owner to clear() and re-insert
+ * its whole set once too many of them have been erased.
+ *
+ * Wire format, carried as one name component of a sync interest:
+ *   MARKER_ESTIMATOR, set size (4 bytes), min(k, size) smallest hashes (4 bytes each)
+ * with all integers in little-endian order and the hashes sorted ascending.
+ */
+class DifferenceEstimator
+{
+public:
+  static const size_t SKETCH_SIZE = 32;
+
+  DifferenceEstimator();
+
+  void
+  insert(uint32_t hash);
+
+  void
+  erase(uint32_t hash);
+
+  void
+  clear();
+
+  /**
+   * @brief Whether erasures left fewer than min(SKETCH_SIZE, size) hashes
+   *        known to be the smallest of the set
+   */
+  bool
+  needsRebuild() const
+  {
+    return m_bottom.size() < std::min(SKETCH_SIZE, m_numElements);
+  }
+
+  size_t
+  getNumElements() const
+  {
+    return m_numElements;
+  }
+
+  void
+  appendToName(ndn::Name& name) const;
+
+  /**
+   * @brief Estimate the number of elements in the symmetric difference of our
+   *        set and the one summarized by @p component
+   *
+   * @param component sketch of the other side, as appended by appendToName
+   * @throws std::invalid_argument if @p component is not a well-formed sketch
+   */
+  size_t
+  estimateDifference(const ndn::name::Component& component) const;
+
+  static bool
+  isEstimatorComponent(const ndn::name::Component& component);
+
+private:
+  size_t m_numElements;
+  // smallest m_bottom.size() hashes of the set
+  std::set<uint32_t> m_bottom;
+};
+
+} // namespace psync
+
+#endif // PSYNC_DIFFERENCE_ESTIMATOR_HPP
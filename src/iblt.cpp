@@ -46,196 +46,896 @@
 #include "iblt.hpp"
 #include "util.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <limits>
+#include <stdexcept>
 #include <sstream>
 #include <iostream>
+#include <type_traits>
 
 namespace psync {
 
-static const size_t N_HASH = 3;
-static const size_t N_HASHCHECK = 11;
+template<typename Traits>
+const size_t BasicIBLT<Traits>::N_HASH;
 
-template<typename T>
-std::vector<unsigned char> ToVec(T number)
+template<typename Traits>
+const size_t BasicIBLT<Traits>::N_HASHCHECK;
+
+template<typename Traits>
+const size_t BasicIBLT<Traits>::CELL_SIZE;
+
+template<typename Traits>
+const size_t BasicIBLT<Traits>::MAX_RECEIVED_FOLD;
+
+/**
+ * @brief A key with its MurmurHash3 blocks already mixed
+ *
+ * The block mix does not depend on the seed, so each hash function
+ * only has to run the seeded rounds and the finalizer.
+ */
+template<typename Key>
+class MixedKey;
+
+template<>
+class MixedKey<uint32_t>
 {
-  std::vector<unsigned char> v(sizeof(T));
+public:
+  explicit
+  MixedKey(uint32_t key)
+    : m_block(MurmurHash3Mix(key))
+  {
+  }
 
-  for (size_t i = 0; i < sizeof(T); i++) {
-    v.at(i) = (number >> i*8) & 0xff;
+  uint32_t
+  hash(uint32_t seed) const
+  {
+    return MurmurHash3Finish(seed, m_block);
   }
 
-  return v;
-}
+private:
+  uint32_t m_block;
+};
 
-bool
-HashTableEntry::isPure() const
+template<>
+class MixedKey<uint64_t>
+{
+public:
+  explicit
+  MixedKey(uint64_t key)
+    : m_low(MurmurHash3Mix(static_cast<uint32_t>(key)))
+    , m_high(MurmurHash3Mix(static_cast<uint32_t>(key >> 32)))
+  {
+  }
+
+  uint32_t
+  hash(uint32_t seed) const
+  {
+    return MurmurHash3Fmix(MurmurHash3Round(MurmurHash3Round(seed, m_low), m_high), 8);
+  }
+
+private:
+  uint32_t m_low;
+  uint32_t m_high;
+};
+
+template<typename Traits>
+static bool
+isPureCell(typename Traits::CountType count, typename Traits::KeyType keySum, uint32_t keyCheck)
 {
   if (count == 1 || count == -1) {
-    uint32_t check = MurmurHash3(N_HASHCHECK, ToVec(keySum));
+    uint32_t check = MurmurHash3(Traits::N_HASHCHECK, keySum);
     return (keyCheck == check);
   }
 
   return false;
 }
 
-bool
-HashTableEntry::empty() const
+/**
+ * @brief Lower bound on the entries folded into @p n cells, see
+ *        BasicIBLT::estimateNumEntries
+ */
+template<typename Traits>
+static size_t
+getEntryLowerBound(const typename Traits::CountType* count, const typename Traits::KeyType* keySum,
+                   const uint32_t* keyCheck, size_t n)
 {
-  return (count == 0 && keySum == 0 && keyCheck == 0);
+  uint64_t sumOfCounts = 0;
+  size_t nonEmpty = 0;
+  for (size_t i = 0; i < n; i++) {
+    int64_t c = count[i];
+    sumOfCounts += c < 0 ? -c : c;
+    nonEmpty += (c != 0 || keySum[i] != 0 || keyCheck[i] != 0);
+  }
+
+  uint64_t cells = std::max<uint64_t>(sumOfCounts, nonEmpty);
+  return (cells + Traits::N_HASH - 1) / Traits::N_HASH;
 }
 
-IBLT::IBLT(size_t _expectedNumEntries)
+/**
+ * @brief Compute the cell of @p key under each hash function and its check value
+ *
+ * The key is mixed once and each hash only repeats the seeded finalizer,
+ * with no temporary buffers.
+ */
+template<typename Traits>
+static void
+hashKey(typename Traits::KeyType key, size_t bucketsPerHash,
+        size_t (&index)[Traits::N_HASH], uint32_t& check)
+{
+  MixedKey<typename Traits::KeyType> mixed(key);
+  for (size_t i = 0; i < Traits::N_HASH; i++) {
+    index[i] = i * bucketsPerHash + (mixed.hash(i) % bucketsPerHash);
+  }
+  check = mixed.hash(Traits::N_HASHCHECK);
+}
+
+template<typename Traits>
+static size_t
+getNumCells(size_t expectedNumEntries)
 {
   // 1.5x expectedNumEntries gives very low probability of
-  // decoding failure
-  size_t nEntries = _expectedNumEntries + _expectedNumEntries/2;
+  // decoding failure, psync-iblt-calibrate measures it
+  size_t nEntries = expectedNumEntries + expectedNumEntries/2;
   // ... make nEntries exactly divisible by N_HASH
-  size_t remainder = nEntries % N_HASH;
+  size_t remainder = nEntries % Traits::N_HASH;
   if (remainder != 0) {
-    nEntries += (N_HASH - remainder);
+    nEntries += (Traits::N_HASH - remainder);
   }
 
-  hashTable.resize(nEntries);
+  return nEntries;
 }
 
-IBLT::IBLT(const IBLT& other)
+template<typename T>
+static void
+putLittleEndian(uint8_t* out, T value)
 {
-  hashTable = other.hashTable;
+  typedef typename std::make_unsigned<T>::type U;
+  U v = static_cast<U>(value);
+  for (size_t i = 0; i < sizeof(T); i++) {
+    out[i] = 0xFF & (v >> (i*8));
+  }
 }
 
-IBLT::IBLT(size_t _expectedNumEntries, std::vector <uint32_t> values)
+template<typename T>
+static T
+getLittleEndian(const uint8_t* in)
 {
-  size_t nEntries = _expectedNumEntries + _expectedNumEntries/2;
+  typedef typename std::make_unsigned<T>::type U;
+  U v = 0;
+  for (size_t i = 0; i < sizeof(T); i++) {
+    v |= static_cast<U>(in[i]) << (i*8);
+  }
+  return static_cast<T>(v);
+}
 
-  size_t remainder = nEntries % N_HASH;
-  if (remainder != 0) {
-    nEntries += (N_HASH - remainder);
+// Field by field little-endian layout for the narrow and wide cell types
+template<typename Count, typename Key>
+static void
+encodeTable(uint8_t* out, const Count* count, const Key* keySum, const uint32_t* keyCheck, size_t n)
+{
+  for (size_t i = 0; i < n; i++) {
+    putLittleEndian(out, count[i]);
+    putLittleEndian(out + sizeof(Count), keySum[i]);
+    putLittleEndian(out + sizeof(Count) + sizeof(Key), keyCheck[i]);
+    out += sizeof(Count) + sizeof(Key) + sizeof(uint32_t);
+  }
+}
+
+// The default 32-bit layout goes through the vector kernels
+static void
+encodeTable(uint8_t* out, const int32_t* count, const uint32_t* keySum,
+            const uint32_t* keyCheck, size_t n)
+{
+  simd::encodeCells(out, count, keySum, keyCheck, n);
+}
+
+template<typename Count, typename Key>
+static void
+decodeTable(const uint8_t* in, Count* count, Key* keySum, uint32_t* keyCheck, size_t n)
+{
+  for (size_t i = 0; i < n; i++) {
+    count[i] = getLittleEndian<Count>(in);
+    keySum[i] = getLittleEndian<Key>(in + sizeof(Count));
+    keyCheck[i] = getLittleEndian<uint32_t>(in + sizeof(Count) + sizeof(Key));
+    in += sizeof(Count) + sizeof(Key) + sizeof(uint32_t);
   }
+}
 
-  hashTable.resize(nEntries);
+static void
+decodeTable(const uint8_t* in, int32_t* count, uint32_t* keySum, uint32_t* keyCheck, size_t n)
+{
+  simd::decodeCells(in, count, keySum, keyCheck, n);
+}
 
-  assert(3 * hashTable.size() == values.size());
+// ours - decoded, field by field
+template<typename Count, typename Key>
+static void
+subtractEncodedTable(const uint8_t* in, const Count* count, const Key* keySum,
+                     const uint32_t* keyCheck, Count* outCount, Key* outKeySum,
+                     uint32_t* outKeyCheck, size_t n)
+{
+  typedef typename std::make_unsigned<Count>::type U;
+  for (size_t i = 0; i < n; i++) {
+    outCount[i] = static_cast<Count>(static_cast<U>(count[i]) -
+                                     static_cast<U>(getLittleEndian<Count>(in)));
+    outKeySum[i] = keySum[i] ^ getLittleEndian<Key>(in + sizeof(Count));
+    outKeyCheck[i] = keyCheck[i] ^ getLittleEndian<uint32_t>(in + sizeof(Count) + sizeof(Key));
+    in += sizeof(Count) + sizeof(Key) + sizeof(uint32_t);
+  }
+}
 
-  for (size_t i = 0; i < hashTable.size(); i++) {
-    HashTableEntry& entry = hashTable.at(i);
-    if (values[i*3] != 0)
-    entry.count = values[i*3];
-    entry.keySum = values[i*3+1];
-    entry.keyCheck = values[i*3+2];
+static void
+subtractEncodedTable(const uint8_t* in, const int32_t* count, const uint32_t* keySum,
+                     const uint32_t* keyCheck, int32_t* outCount, uint32_t* outKeySum,
+                     uint32_t* outKeyCheck, size_t n)
+{
+  simd::subtractEncodedCells(in, count, keySum, keyCheck, outCount, outKeySum, outKeyCheck, n);
+}
+
+static const uint8_t COMPACT_FORMAT_VERSION = 1;
+// MARKER_IBLT_FORMAT, COMPACT_FORMAT_VERSION, number of cells
+static const size_t COMPACT_HEADER_SIZE = 6;
+// m_cachedVersion of a table whose components were never encoded
+static const uint64_t NO_CACHED_VERSION = std::numeric_limits<uint64_t>::max();
+static const uint8_t DELTA_FORMAT_VERSION = 2;
+// MARKER_IBLT_FORMAT, DELTA_FORMAT_VERSION, base digest
+static const size_t DELTA_HEADER_SIZE = 6;
+// MARKER_DIGEST, digest
+static const size_t DIGEST_COMPONENT_SIZE = 5;
+
+static bool
+isCompactHeader(const ndn::name::Component& ibltHeader)
+{
+  // A plain header is a number component, which is never 6 bytes long
+  return ibltHeader.value_size() == COMPACT_HEADER_SIZE &&
+         ibltHeader.value()[0] == MARKER_IBLT_FORMAT &&
+         ibltHeader.value()[1] == COMPACT_FORMAT_VERSION;
+}
+
+template<typename Traits>
+static bool
+canFold(size_t from, size_t to)
+{
+  return from != 0 && to != 0 && from % Traits::N_HASH == 0 && to % Traits::N_HASH == 0 &&
+         (from / Traits::N_HASH) % (to / Traits::N_HASH) == 0;
+}
+
+/**
+ * @brief Add (or with @p isSubtract, subtract) the @p srcN cells of src onto
+ *        the @p dstN cells of dst they fold to, canFold(srcN, dstN) must hold
+ */
+template<typename Traits>
+static void
+foldCells(const typename Traits::CountType* srcCount, const typename Traits::KeyType* srcKeySum,
+          const uint32_t* srcKeyCheck, size_t srcN,
+          typename Traits::CountType* dstCount, typename Traits::KeyType* dstKeySum,
+          uint32_t* dstKeyCheck, size_t dstN, bool isSubtract)
+{
+  typedef typename std::make_unsigned<typename Traits::CountType>::type U;
+  size_t srcPartition = srcN / Traits::N_HASH;
+  size_t dstPartition = dstN / Traits::N_HASH;
+  for (size_t i = 0; i < srcN; i++) {
+    size_t j = (i / srcPartition) * dstPartition + (i % srcPartition) % dstPartition;
+    U count = isSubtract ? -static_cast<U>(srcCount[i]) : static_cast<U>(srcCount[i]);
+    dstCount[j] = static_cast<typename Traits::CountType>(static_cast<U>(dstCount[j]) + count);
+    dstKeySum[j] ^= srcKeySum[i];
+    dstKeyCheck[j] ^= srcKeyCheck[i];
   }
 }
 
+template<typename T>
+static T
+wrappingSubtract(T a, T b)
+{
+  typedef typename std::make_unsigned<T>::type U;
+  return static_cast<T>(static_cast<U>(a) - static_cast<U>(b));
+}
+
+static void
+putVarint(std::vector<uint8_t>& out, uint64_t value)
+{
+  while (value >= 0x80) {
+    out.push_back(static_cast<uint8_t>(value) | 0x80);
+    value >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+static bool
+getVarint(const uint8_t*& in, const uint8_t* end, uint64_t& value)
+{
+  value = 0;
+  for (size_t shift = 0; ; shift += 7) {
+    if (in == end || shift > 63) {
+      return false;
+    }
+    uint8_t byte = *in++;
+    value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+}
+
+template<typename Count>
+static void
+putZigZagVarint(std::vector<uint8_t>& out, Count value)
+{
+  int64_t v = value;
+  putVarint(out, (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63));
+}
+
+template<typename Count>
+static bool
+getZigZagVarint(const uint8_t*& in, const uint8_t* end, Count& value)
+{
+  uint64_t z;
+  if (!getVarint(in, end, z)) {
+    return false;
+  }
+
+  int64_t v = static_cast<int64_t>(z >> 1) ^ -static_cast<int64_t>(z & 1);
+  if (v < std::numeric_limits<Count>::min() || v > std::numeric_limits<Count>::max()) {
+    return false;
+  }
+  value = static_cast<Count>(v);
+  return true;
+}
+
+template<typename Count, typename Key>
+static void
+putCompactCell(std::vector<uint8_t>& out, Count count, Key keySum, uint32_t keyCheck)
+{
+  putZigZagVarint(out, count);
+  size_t offset = out.size();
+  out.resize(offset + sizeof(Key) + sizeof(uint32_t));
+  putLittleEndian(&out[offset], keySum);
+  putLittleEndian(&out[offset + sizeof(Key)], keyCheck);
+}
+
+template<typename Count, typename Key>
+static bool
+getCompactCell(const uint8_t*& in, const uint8_t* end, Count& count, Key& keySum,
+               uint32_t& keyCheck)
+{
+  if (!getZigZagVarint(in, end, count) ||
+      static_cast<size_t>(end - in) < sizeof(Key) + sizeof(uint32_t)) {
+    return false;
+  }
+  keySum = getLittleEndian<Key>(in);
+  keyCheck = getLittleEndian<uint32_t>(in + sizeof(Key));
+  in += sizeof(Key) + sizeof(uint32_t);
+  return true;
+}
+
+template<typename Count, typename Key>
+static std::vector<uint8_t>
+encodeCompactTable(const Count* count, const Key* keySum, const uint32_t* keyCheck, size_t n)
+{
+  std::vector<uint8_t> out((n + 7) / 8, 0);
+  for (size_t i = 0; i < n; i++) {
+    if (count[i] == 0 && keySum[i] == 0 && keyCheck[i] == 0) {
+      continue;
+    }
+    out[i / 8] |= 1 << (i % 8);
+    putCompactCell(out, count[i], keySum[i], keyCheck[i]);
+  }
+  return out;
+}
+
+/**
+ * @brief Call @p onCell(index, count, keySum, keyCheck) for each non-empty cell
+ *        of a compact table of @p n cells
+ *
+ * @return false if the table is truncated, has trailing bytes or marks cells
+ *         past @p n
+ */
+template<typename Count, typename Key, typename OnCell>
+static bool
+decodeCompactTable(const uint8_t* in, size_t size, size_t n, const OnCell& onCell)
+{
+  size_t bitmapSize = (n + 7) / 8;
+  if (size < bitmapSize) {
+    return false;
+  }
+
+  const uint8_t* bitmap = in;
+  const uint8_t* end = in + size;
+  in += bitmapSize;
+  for (size_t byte = 0; byte < bitmapSize; byte++) {
+    if (bitmap[byte] == 0) {
+      continue;
+    }
+    for (size_t bit = 0; bit < 8; bit++) {
+      if ((bitmap[byte] & (1 << bit)) == 0) {
+        continue;
+      }
+      size_t i = byte * 8 + bit;
+      Count count;
+      Key keySum;
+      uint32_t keyCheck;
+      if (i >= n || !getCompactCell(in, end, count, keySum, keyCheck)) {
+        return false;
+      }
+      onCell(i, count, keySum, keyCheck);
+    }
+  }
+  return in == end;
+}
+
+template<typename Traits>
+bool
+BasicHashTableEntry<Traits>::isPure() const
+{
+  return isPureCell<Traits>(count, keySum, keyCheck);
+}
+
+template<typename Traits>
+bool
+BasicHashTableEntry<Traits>::empty() const
+{
+  return (count == 0 && keySum == 0 && keyCheck == 0);
+}
+
+template<typename Traits>
+BasicIBLT<Traits>::BasicIBLT(size_t _expectedNumEntries)
+  : m_version(0)
+  , m_cachedVersion(NO_CACHED_VERSION)
+  , m_cachedFormat(IBLT_WIRE_COMPACT)
+{
+  size_t nEntries = getNumCells<Traits>(_expectedNumEntries);
+
+  m_count.resize(nEntries);
+  m_keySum.resize(nEntries);
+  m_keyCheck.resize(nEntries);
+}
+
+template<typename Traits>
+BasicIBLT<Traits>::BasicIBLT(const BasicIBLT& other)
+  : m_count(other.m_count)
+  , m_keySum(other.m_keySum)
+  , m_keyCheck(other.m_keyCheck)
+  , m_version(other.m_version)
+  , m_cachedVersion(other.m_cachedVersion)
+  , m_cachedFormat(other.m_cachedFormat)
+  , m_cachedHeader(other.m_cachedHeader)
+  , m_cachedTable(other.m_cachedTable)
+{
+}
+
+template<typename Traits>
+BasicIBLT<Traits>::BasicIBLT(size_t _expectedNumEntries, std::vector <uint32_t> values)
+  : BasicIBLT(_expectedNumEntries)
+{
+  const size_t keyWords = sizeof(KeyType)/sizeof(uint32_t);
+  const size_t cellWords = keyWords + 2;
+
+  assert(cellWords * m_count.size() == values.size());
+
+  size_t N = std::min(m_count.size(), values.size()/cellWords);
+  for (size_t i = 0; i < N; i++) {
+    const uint32_t* cell = values.data() + i * cellWords;
+    m_count[i] = static_cast<CountType>(cell[0]);
+    KeyType keySum = 0;
+    for (size_t j = 0; j < keyWords; j++) {
+      keySum |= static_cast<KeyType>(cell[1 + j]) << (j*32);
+    }
+    m_keySum[i] = keySum;
+    m_keyCheck[i] = cell[1 + keyWords];
+  }
+}
+
+template<typename Traits>
 void
-IBLT::_insert(int plusOrMinus, uint32_t key)
+BasicIBLT<Traits>::_insert(int plusOrMinus, KeyType key)
 {
-  std::vector<uint8_t> kvec = ToVec(key);
+  size_t index[N_HASH];
+  uint32_t check;
+  hashKey<Traits>(key, m_count.size()/N_HASH, index, check);
 
-  size_t bucketsPerHash = hashTable.size()/N_HASH;
   for (size_t i = 0; i < N_HASH; i++) {
-    size_t startEntry = i * bucketsPerHash;
-    uint32_t h = MurmurHash3(i, kvec);
-    HashTableEntry& entry = hashTable.at(startEntry + (h % bucketsPerHash));
-    entry.count += plusOrMinus;
-    entry.keySum ^= key;
-    entry.keyCheck ^= MurmurHash3(N_HASHCHECK, kvec);
-    //std::cout << "Index is: " << startEntry + (h%bucketsPerHash) << " " <<
-    //  key << " " << MurmurHash3(N_HASHCHECK, kvec) << std::endl;
+    m_count[index[i]] += plusOrMinus;
+    m_keySum[index[i]] ^= key;
+    m_keyCheck[index[i]] ^= check;
   }
+  m_version++;
 }
 
+template<typename Traits>
 void
-IBLT::insert(uint32_t key)
+BasicIBLT<Traits>::insert(KeyType key)
 {
   _insert(1, key);
 }
 
+template<typename Traits>
 void
-IBLT::erase(uint32_t key)
+BasicIBLT<Traits>::erase(KeyType key)
 {
   _insert(-1, key);
 }
 
+template<typename Traits>
 bool
-IBLT::listEntries(std::set<uint32_t>& positive, std::set<uint32_t>& negative) const
-{
-  IBLT peeled = *this;
-
-  // WHY DO WE NEED THE DO WHILE HERE?
-  size_t nErased = 0;
-  do {
-    nErased = 0;
-    for (size_t i = 0; i < peeled.hashTable.size(); i++) {
-      HashTableEntry& entry = peeled.hashTable.at(i);
-      if (entry.isPure()) {
-        if (entry.count == 1) {
-          positive.insert(entry.keySum);
-        }
-        else {
-          negative.insert(entry.keySum);
-        }
-        peeled._insert(-entry.count, entry.keySum);
-        ++nErased;
-      }
+BasicIBLT<Traits>::listEntries(std::set<KeyType>& positive, std::set<KeyType>& negative) const
+{
+  PeelWorkspace workspace;
+  return listEntries(positive, negative, workspace) == PEEL_COMPLETE;
+}
+
+/**
+ * @brief Peel visitor collecting the entries into two containers
+ */
+template<typename Container>
+class CollectEntries
+{
+public:
+  CollectEntries(Container& positive, Container& negative)
+    : m_positive(positive)
+    , m_negative(negative)
+  {
+  }
+
+  template<typename Key>
+  void
+  operator()(Key key, bool isPositive) const
+  {
+    insert(isPositive ? m_positive : m_negative, key);
+  }
+
+private:
+  template<typename Key>
+  static void
+  insert(std::set<Key>& entries, Key key)
+  {
+    entries.insert(key);
+  }
+
+  template<typename Key>
+  static void
+  insert(std::vector<Key>& entries, Key key)
+  {
+    entries.push_back(key);
+  }
+
+private:
+  Container& m_positive;
+  Container& m_negative;
+};
+
+template<typename Container>
+static CollectEntries<Container>
+collectEntries(Container& positive, Container& negative)
+{
+  return CollectEntries<Container>(positive, negative);
+}
+
+template<typename Traits>
+PeelResult
+BasicIBLT<Traits>::listEntries(std::set<KeyType>& positive, std::set<KeyType>& negative,
+                               PeelWorkspace& workspace, size_t maxEntries) const
+{
+  copyInto(workspace);
+  return peel(workspace, maxEntries, collectEntries(positive, negative));
+}
+
+template<typename Traits>
+PeelResult
+BasicIBLT<Traits>::listEntries(std::vector<KeyType>& positive, std::vector<KeyType>& negative,
+                               PeelWorkspace& workspace, size_t maxEntries) const
+{
+  copyInto(workspace);
+  return peel(workspace, maxEntries, collectEntries(positive, negative));
+}
+
+template<typename Traits>
+PeelResult
+BasicIBLT<Traits>::listEntries(const EntryVisitor& visitor, PeelWorkspace& workspace,
+                               size_t maxEntries) const
+{
+  copyInto(workspace);
+  return peel(workspace, maxEntries, visitor);
+}
+
+template<typename Traits>
+PeelResult
+BasicIBLT<Traits>::listDifference(const ndn::name::Component& ibltHeader,
+                                  const ndn::name::Component& ibltName,
+                                  std::set<KeyType>& positive, std::set<KeyType>& negative,
+                                  PeelWorkspace& workspace, size_t maxEntries) const
+{
+  if (!subtractInto(ibltHeader, ibltName, workspace)) {
+    return PEEL_FAILED;
+  }
+  return peel(workspace, maxEntries, collectEntries(positive, negative));
+}
+
+template<typename Traits>
+PeelResult
+BasicIBLT<Traits>::listDifference(const BasicIBLT& other,
+                                  std::set<KeyType>& positive, std::set<KeyType>& negative,
+                                  PeelWorkspace& workspace, size_t maxEntries) const
+{
+  if (!subtractInto(other, workspace)) {
+    return PEEL_FAILED;
+  }
+  return peel(workspace, maxEntries, collectEntries(positive, negative));
+}
+
+template<typename Traits>
+PeelResult
+BasicIBLT<Traits>::listDifference(const BasicIBLT& other,
+                                  std::vector<KeyType>& positive, std::vector<KeyType>& negative,
+                                  PeelWorkspace& workspace, size_t maxEntries) const
+{
+  if (!subtractInto(other, workspace)) {
+    return PEEL_FAILED;
+  }
+  return peel(workspace, maxEntries, collectEntries(positive, negative));
+}
+
+template<typename Traits>
+PeelResult
+BasicIBLT<Traits>::listDifference(const BasicIBLT& other, const EntryVisitor& visitor,
+                                  PeelWorkspace& workspace, size_t maxEntries) const
+{
+  if (!subtractInto(other, workspace)) {
+    return PEEL_FAILED;
+  }
+  return peel(workspace, maxEntries, visitor);
+}
+
+template<typename Traits>
+void
+BasicIBLT<Traits>::copyInto(PeelWorkspace& workspace) const
+{
+  workspace.count.assign(m_count.begin(), m_count.end());
+  workspace.keySum.assign(m_keySum.begin(), m_keySum.end());
+  workspace.keyCheck.assign(m_keyCheck.begin(), m_keyCheck.end());
+}
+
+template<typename Traits>
+bool
+BasicIBLT<Traits>::subtractInto(const ndn::name::Component& ibltHeader,
+                                const ndn::name::Component& ibltName,
+                                PeelWorkspace& workspace) const
+{
+  size_t N = m_count.size();
+  size_t receivedN;
+  if (!getReceivedNumCells(ibltHeader, ibltName, receivedN)) {
+    return false;
+  }
+
+  // A table of another size is decoded and folded, it takes the slow path
+  if (receivedN != N) {
+    try {
+      return subtractInto(getIBLTFromName(ibltHeader, ibltName), workspace);
     }
-  } while (nErased > 0);
+    catch (const std::invalid_argument&) {
+      return false;
+    }
+  }
 
-  // If any buckets for one of the hash functions is not empty,
-  // then we didn't peel them all:
-  for (size_t i = 0; i < peeled.hashTable.size(); i++) {
-    if (peeled.hashTable.at(i).empty() != true) {
+  if (isCompactHeader(ibltHeader)) {
+    // Start from our table and take out only the received non-empty cells
+    copyInto(workspace);
+    return decodeCompactTable<CountType, KeyType>(
+      ibltName.value(), ibltName.value_size(), N,
+      [&workspace] (size_t i, CountType count, KeyType keySum, uint32_t keyCheck) {
+        workspace.count[i] = wrappingSubtract(workspace.count[i], count);
+        workspace.keySum[i] ^= keySum;
+        workspace.keyCheck[i] ^= keyCheck;
+      });
+  }
+
+  workspace.count.resize(N);
+  workspace.keySum.resize(N);
+  workspace.keyCheck.resize(N);
+  subtractEncodedTable(ibltName.value(), m_count.data(), m_keySum.data(), m_keyCheck.data(),
+                       workspace.count.data(), workspace.keySum.data(),
+                       workspace.keyCheck.data(), N);
+  return true;
+}
+
+template<typename Traits>
+bool
+BasicIBLT<Traits>::subtractInto(const BasicIBLT& other, PeelWorkspace& workspace) const
+{
+  size_t N = m_count.size();
+  if (other.m_count.size() != N) {
+    N = std::min(N, other.m_count.size());
+    if (!canFoldTo(N) || !other.canFoldTo(N)) {
       return false;
     }
+    workspace.count.assign(N, 0);
+    workspace.keySum.assign(N, 0);
+    workspace.keyCheck.assign(N, 0);
+    foldCells<Traits>(m_count.data(), m_keySum.data(), m_keyCheck.data(), m_count.size(),
+                      workspace.count.data(), workspace.keySum.data(), workspace.keyCheck.data(),
+                      N, false);
+    foldCells<Traits>(other.m_count.data(), other.m_keySum.data(), other.m_keyCheck.data(),
+                      other.m_count.size(), workspace.count.data(), workspace.keySum.data(),
+                      workspace.keyCheck.data(), N, true);
+    return true;
   }
 
+  workspace.count.resize(N);
+  workspace.keySum.resize(N);
+  workspace.keyCheck.resize(N);
+  simd::subtract(workspace.count.data(), m_count.data(), other.m_count.data(), N);
+  simd::exclusiveOr(workspace.keySum.data(), m_keySum.data(), other.m_keySum.data(),
+                    N * sizeof(KeyType));
+  simd::exclusiveOr(workspace.keyCheck.data(), m_keyCheck.data(), other.m_keyCheck.data(),
+                    N * sizeof(uint32_t));
   return true;
 }
 
-IBLT
-IBLT::operator-(const IBLT& other) const
+template<typename Traits>
+template<typename OnEntry>
+PeelResult
+BasicIBLT<Traits>::peel(PeelWorkspace& workspace, size_t maxEntries, const OnEntry& onEntry)
 {
-  //std::cout << hashTable.size() << " == " << other.hashTable.size() << std::endl;
-  assert(hashTable.size() == other.hashTable.size());
+  simd::AlignedVector<CountType>& count = workspace.count;
+  simd::AlignedVector<KeyType>& keySum = workspace.keySum;
+  simd::AlignedVector<uint32_t>& keyCheck = workspace.keyCheck;
+  std::vector<size_t>& queue = workspace.queue;
 
-  IBLT result(*this);
-  for (size_t i = 0; i < hashTable.size(); i++) {
-    HashTableEntry& e1 = result.hashTable.at(i);
-    const HashTableEntry& e2 = other.hashTable.at(i);
-    e1.count -= e2.count;
-    e1.keySum ^= e2.keySum;
-    e1.keyCheck ^= e2.keyCheck;
+  queue.clear();
+  queue.reserve(count.size());
+
+  size_t N = count.size();
+  for (size_t i = 0; i < N; i++) {
+    if (isPureCell<Traits>(count[i], keySum[i], keyCheck[i])) {
+      queue.push_back(i);
+    }
+  }
+
+  // Taken before peeling changes the cells, only needed if peeling gets stuck
+  // short of maxEntries
+  size_t lowerBound = 0;
+  if (maxEntries != std::numeric_limits<size_t>::max()) {
+    lowerBound = getEntryLowerBound<Traits>(count.data(), keySum.data(), keyCheck.data(), N);
+  }
+
+  size_t numPeeled = 0;
+  size_t bucketsPerHash = N/N_HASH;
+  while (!queue.empty()) {
+    size_t i = queue.back();
+    queue.pop_back();
+
+    // The cell may have been emptied or had another key folded back
+    // into it since it was queued
+    if (!isPureCell<Traits>(count[i], keySum[i], keyCheck[i])) {
+      continue;
+    }
+
+    CountType c = count[i];
+    KeyType key = keySum[i];
+    onEntry(key, c == 1);
+    numPeeled++;
+
+    size_t cells[N_HASH];
+    uint32_t check;
+    hashKey<Traits>(key, bucketsPerHash, cells, check);
+    for (size_t j = 0; j < N_HASH; j++) {
+      size_t index = cells[j];
+      count[index] -= c;
+      keySum[index] ^= key;
+      keyCheck[index] ^= check;
+      // Only the cells touched by this removal can have become pure
+      if (index != i && isPureCell<Traits>(count[index], keySum[index], keyCheck[index])) {
+        queue.push_back(index);
+      }
+    }
+
+    if (numPeeled >= maxEntries) {
+      break;
+    }
   }
 
+  // If any buckets for one of the hash functions is not empty,
+  // then we didn't peel them all. The last entry before the bound may also
+  // have been the last one in the table.
+  if (simd::isZero(count.data(), N * sizeof(CountType)) &&
+      simd::isZero(keySum.data(), N * sizeof(KeyType)) &&
+      simd::isZero(keyCheck.data(), N * sizeof(uint32_t))) {
+    return PEEL_COMPLETE;
+  }
+  return numPeeled >= maxEntries || lowerBound >= maxEntries ? PEEL_AT_BOUND : PEEL_FAILED;
+}
+
+template<typename Traits>
+size_t
+BasicIBLT<Traits>::estimateNumEntries() const
+{
+  return getEntryLowerBound<Traits>(m_count.data(), m_keySum.data(), m_keyCheck.data(),
+                                    m_count.size());
+}
+
+template<typename Traits>
+BasicIBLT<Traits>
+BasicIBLT<Traits>::operator-(const BasicIBLT& other) const
+{
+  if (m_count.size() < other.m_count.size()) {
+    return *this - other.fold(m_count.size());
+  }
+
+  // Fold or size the result without copying our cells (and cached encoding),
+  // they are all overwritten below
+  size_t N = other.m_count.size();
+  BasicIBLT result(0);
+  if (m_count.size() != N) {
+    result = fold(N);
+  }
+  else {
+    result.m_count.resize(N);
+    result.m_keySum.resize(N);
+    result.m_keyCheck.resize(N);
+  }
+  const BasicIBLT& left = m_count.size() != N ? result : *this;
+
+  simd::subtract(result.m_count.data(), left.m_count.data(), other.m_count.data(), N);
+  simd::exclusiveOr(result.m_keySum.data(), left.m_keySum.data(), other.m_keySum.data(),
+                    N * sizeof(KeyType));
+  simd::exclusiveOr(result.m_keyCheck.data(), left.m_keyCheck.data(), other.m_keyCheck.data(),
+                    N * sizeof(uint32_t));
+
   return result;
 }
 
+template<typename Traits>
 bool
-IBLT::operator==(const IBLT& other) const
+BasicIBLT<Traits>::operator==(const BasicIBLT& other) const
 {
-  if (this->hashTable.size() != other.hashTable.size())
+  if (m_count.size() != other.m_count.size())
     return false;
 
-  size_t N = this->hashTable.size();
+  size_t N = m_count.size();
 
-  for (size_t i = 0; i < N; i++) {
-    if (this->hashTable[i].count != other.hashTable[i].count ||
-        this->hashTable[i].keySum != other.hashTable[i].keySum ||
-        this->hashTable[i].keyCheck != other.hashTable[i].keyCheck)
-      return false;
+  return simd::equal(m_count.data(), other.m_count.data(), N * sizeof(CountType)) &&
+         simd::equal(m_keySum.data(), other.m_keySum.data(), N * sizeof(KeyType)) &&
+         simd::equal(m_keyCheck.data(), other.m_keyCheck.data(), N * sizeof(uint32_t));
+}
+
+template<typename Traits>
+bool
+BasicIBLT<Traits>::empty() const
+{
+  size_t N = m_count.size();
+
+  return simd::isZero(m_count.data(), N * sizeof(CountType)) &&
+         simd::isZero(m_keySum.data(), N * sizeof(KeyType)) &&
+         simd::isZero(m_keyCheck.data(), N * sizeof(uint32_t));
+}
+
+template<typename Traits>
+std::vector<typename BasicIBLT<Traits>::HashTableEntry>
+BasicIBLT<Traits>::getHashTable() const
+{
+  std::vector<HashTableEntry> hashTable(m_count.size());
+
+  for (size_t i = 0; i < hashTable.size(); i++) {
+    hashTable[i].count = m_count[i];
+    hashTable[i].keySum = m_keySum[i];
+    hashTable[i].keyCheck = m_keyCheck[i];
   }
 
-  return true;
+  return hashTable;
 }
 
+template<typename Traits>
 std::string
-IBLT::DumpTable() const
+BasicIBLT<Traits>::DumpTable() const
 {
   std::ostringstream result;
 
   result << "count keySum keyCheckMatch\n";
-  for (size_t i = 0; i < hashTable.size(); i++) {
-    const HashTableEntry& entry = hashTable.at(i);
-    result << entry.count << " " << entry.keySum << " ";
-    result << ((MurmurHash3(N_HASHCHECK, ToVec(entry.keySum)) == entry.keyCheck) ||
+  CellView cells = getCells();
+  for (size_t i = 0; i < cells.size; i++) {
+    HashTableEntry entry{cells.count[i], cells.keySum[i], cells.keyCheck[i]};
+    result << static_cast<int>(entry.count) << " " << entry.keySum << " ";
+    result << ((MurmurHash3(N_HASHCHECK, entry.keySum) == entry.keyCheck) ||
               (entry.empty())? "true" : "false");
     result << "\n";
   }
@@ -243,56 +943,247 @@ IBLT::DumpTable() const
   return result.str();
 }
 
+template<typename Traits>
 void
-IBLT::appendToName(ndn::Name& name) const
+BasicIBLT<Traits>::appendToName(ndn::Name& name, IBLTWireFormat format) const
 {
-  size_t N = hashTable.size();
-  size_t unitSize = 32*3/8; // hard coding
-  size_t tableSize = unitSize*N;
+  if (m_cachedVersion != m_version || m_cachedFormat != format) {
+    size_t N = m_count.size();
 
-  std::vector <uint8_t> table(tableSize);
+    if (format == IBLT_WIRE_COMPACT) {
+      uint8_t header[COMPACT_HEADER_SIZE] = {MARKER_IBLT_FORMAT, COMPACT_FORMAT_VERSION};
+      putLittleEndian(header + 2, static_cast<uint32_t>(N));
+      std::vector<uint8_t> table = encodeCompactTable(m_count.data(), m_keySum.data(),
+                                                      m_keyCheck.data(), N);
+      m_cachedHeader = ndn::name::Component(header, header + sizeof(header));
+      m_cachedTable = ndn::name::Component(table.begin(), table.end());
+    }
+    else {
+      std::vector <uint8_t> table(CELL_SIZE*N);
+      encodeTable(table.data(), m_count.data(), m_keySum.data(), m_keyCheck.data(), N);
 
-  for (uint i = 0; i < N; i++) {
-    // table[i*12],   table[i*12+1], table[i*12+2], table[i*12+3] --> hashTable[i].count
+      m_cachedHeader = ndn::name::Component::fromNumber(table.size());
+      m_cachedTable = ndn::name::Component(table.begin(), table.end());
+    }
 
-    table[i*12]   = 0xFF & hashTable[i].count;
-    table[i*12+1] = 0xFF & (hashTable[i].count >> 8);
-    table[i*12+2] = 0xFF & (hashTable[i].count >> 16);
-    table[i*12+3] = 0xFF & (hashTable[i].count >> 24);
+    m_cachedVersion = m_version;
+    m_cachedFormat = format;
+  }
 
-    // table[i*12+4], table[i*12+5], table[i*12+6], table[i*12+7] --> hashTable[i].keySum
+  name.append(m_cachedHeader);
+  name.append(m_cachedTable);
+}
 
-    table[i*12+4] = 0xFF & hashTable[i].keySum;
-    table[i*12+5] = 0xFF & (hashTable[i].keySum >> 8);
-    table[i*12+6] = 0xFF & (hashTable[i].keySum >> 16);
-    table[i*12+7] = 0xFF & (hashTable[i].keySum >> 24);
+template<typename Traits>
+BasicIBLT<Traits>
+BasicIBLT<Traits>::getIBLTFromName(const ndn::name::Component& ibltHeader,
+                                   const ndn::name::Component& ibltName) const
+{
+  size_t N = 0;
+  if (!getReceivedNumCells(ibltHeader, ibltName, N)) {
+    throw std::invalid_argument("Not an IBLT of at most " +
+                                std::to_string(MAX_RECEIVED_FOLD * m_count.size()) + " cells");
+  }
+  if (!canFold<Traits>(N, m_count.size()) && !canFoldTo(N)) {
+    throw std::invalid_argument("IBLT of " + std::to_string(N) + " cells does not fold with ours");
+  }
 
-    // table[i*12+8], table[i*12+9], table[i*12+10], table[i*12+11] --> hashTable[i].keyCheck
+  BasicIBLT iblt(0);
+  iblt.m_count.resize(N);
+  iblt.m_keySum.resize(N);
+  iblt.m_keyCheck.resize(N);
 
-    table[i*12+8] = 0xFF & hashTable[i].keyCheck;
-    table[i*12+9] = 0xFF & (hashTable[i].keyCheck >> 8);
-    table[i*12+10] = 0xFF & (hashTable[i].keyCheck >> 16);
-    table[i*12+11] = 0xFF & (hashTable[i].keyCheck >> 24);
+  if (isCompactHeader(ibltHeader)) {
+    bool isValid = decodeCompactTable<CountType, KeyType>(
+      ibltName.value(), ibltName.value_size(), N,
+      [&iblt] (size_t i, CountType count, KeyType keySum, uint32_t keyCheck) {
+        iblt.m_count[i] = count;
+        iblt.m_keySum[i] = keySum;
+        iblt.m_keyCheck[i] = keyCheck;
+      });
+    if (!isValid) {
+      throw std::invalid_argument("Malformed compact IBLT");
+    }
+    return iblt;
   }
 
-  name.appendNumber(table.size());
+  decodeTable(ibltName.value(), iblt.m_count.data(), iblt.m_keySum.data(),
+              iblt.m_keyCheck.data(), N);
+
+  return iblt;
+}
+
+template<typename Traits>
+bool
+BasicIBLT<Traits>::canReadFromName(const ndn::name::Component& ibltHeader,
+                                   const ndn::name::Component& ibltName) const
+{
+  size_t N;
+  return getReceivedNumCells(ibltHeader, ibltName, N) &&
+         (canFold<Traits>(N, m_count.size()) || canFoldTo(N));
+}
+
+template<typename Traits>
+bool
+BasicIBLT<Traits>::getReceivedNumCells(const ndn::name::Component& ibltHeader,
+                                       const ndn::name::Component& ibltName,
+                                       size_t& numCells) const
+{
+  if (isCompactHeader(ibltHeader)) {
+    numCells = getLittleEndian<uint32_t>(ibltHeader.value() + 2);
+    // Even with every cell empty the table holds their bitmap
+    return numCells <= MAX_RECEIVED_FOLD * m_count.size() &&
+           ibltName.value_size() >= (numCells + 7) / 8;
+  }
+
+  if (isDeltaHeader(ibltHeader) || ibltName.value_size() % CELL_SIZE != 0) {
+    return false;
+  }
+  numCells = ibltName.value_size() / CELL_SIZE;
+  return numCells <= MAX_RECEIVED_FOLD * m_count.size();
+}
+
+template<typename Traits>
+bool
+BasicIBLT<Traits>::canFoldTo(size_t numCells) const
+{
+  return canFold<Traits>(m_count.size(), numCells);
+}
+
+template<typename Traits>
+BasicIBLT<Traits>
+BasicIBLT<Traits>::fold(size_t numCells) const
+{
+  if (!canFoldTo(numCells)) {
+    throw std::invalid_argument("IBLT of " + std::to_string(m_count.size()) +
+                                " cells does not fold onto " + std::to_string(numCells));
+  }
+
+  BasicIBLT result(0);
+  result.m_count.resize(numCells);
+  result.m_keySum.resize(numCells);
+  result.m_keyCheck.resize(numCells);
+  foldCells<Traits>(m_count.data(), m_keySum.data(), m_keyCheck.data(), m_count.size(),
+                    result.m_count.data(), result.m_keySum.data(), result.m_keyCheck.data(),
+                    numCells, false);
+  return result;
+}
+
+template<typename Traits>
+void
+BasicIBLT<Traits>::appendDeltaToName(ndn::Name& name, const BasicIBLT& base) const
+{
+  uint8_t header[DELTA_HEADER_SIZE] = {MARKER_IBLT_FORMAT, DELTA_FORMAT_VERSION};
+  putLittleEndian(header + 2, base.getDigest());
+
+  std::vector<uint8_t> table;
+  size_t previous = 0;
+  for (size_t i = 0; i < m_count.size(); i++) {
+    if (m_count[i] == base.m_count[i] && m_keySum[i] == base.m_keySum[i] &&
+        m_keyCheck[i] == base.m_keyCheck[i]) {
+      continue;
+    }
+    putVarint(table, i - previous);
+    putCompactCell(table, m_count[i], m_keySum[i], m_keyCheck[i]);
+    previous = i;
+  }
+
+  name.append(header, sizeof(header));
   name.append(table.begin(), table.end());
 }
 
-IBLT
-IBLT::getIBLTFromName(size_t expectedNumEntries, size_t ibltSize,
-                      const ndn::name::Component& ibltName) const
+template<typename Traits>
+bool
+BasicIBLT<Traits>::isDeltaHeader(const ndn::name::Component& ibltHeader)
 {
-  std::vector<uint8_t> ibltValues(ibltName.begin() + getSize(ibltSize), ibltName.end());
-  size_t N = ibltValues.size()/4;
-  std::vector<uint32_t> values(N, 0);
+  // Number components, the plain header, are never 6 bytes long
+  return ibltHeader.value_size() == DELTA_HEADER_SIZE &&
+         ibltHeader.value()[0] == MARKER_IBLT_FORMAT &&
+         ibltHeader.value()[1] == DELTA_FORMAT_VERSION;
+}
+
+template<typename Traits>
+uint32_t
+BasicIBLT<Traits>::getDeltaBase(const ndn::name::Component& ibltHeader)
+{
+  return getLittleEndian<uint32_t>(ibltHeader.value() + 2);
+}
+
+template<typename Traits>
+bool
+BasicIBLT<Traits>::applyDelta(const ndn::name::Component& ibltName)
+{
+  const uint8_t* in = ibltName.value();
+  const uint8_t* end = in + ibltName.value_size();
+  m_version++;
+  uint64_t i = 0;
+  while (in != end) {
+    uint64_t gap;
+    if (!getVarint(in, end, gap) || gap >= m_count.size() - i ||
+        !getCompactCell(in, end, m_count[i + gap], m_keySum[i + gap], m_keyCheck[i + gap])) {
+      return false;
+    }
+    i += gap;
+  }
+  return true;
+}
 
-  for (uint i = 0; i < 4*N; i += 4) {
-    uint32_t t = (ibltValues[i+3] << 24) + (ibltValues[i+2] << 16) + (ibltValues[i+1] << 8) + ibltValues[i];
-    values[i/4] = t;
+template<typename Traits>
+uint32_t
+BasicIBLT<Traits>::getDigest() const
+{
+  // MurmurHash3 over every field, 32 bits at a time
+  uint32_t h1 = 0;
+  for (size_t i = 0; i < m_count.size(); i++) {
+    h1 = MurmurHash3Round(h1, MurmurHash3Mix(static_cast<uint32_t>(m_count[i])));
+    for (size_t word = 0; word < sizeof(KeyType) / 4; word++) {
+      h1 = MurmurHash3Round(h1, MurmurHash3Mix(static_cast<uint32_t>(m_keySum[i] >> (32 * word))));
+    }
+    h1 = MurmurHash3Round(h1, MurmurHash3Mix(m_keyCheck[i]));
   }
+  return MurmurHash3Fmix(h1, static_cast<uint32_t>(m_count.size() * (2 + sizeof(KeyType) / 4) * 4));
+}
 
-  return IBLT(expectedNumEntries, values);
+template<typename Traits>
+void
+BasicIBLT<Traits>::appendDigestToName(ndn::Name& name, uint32_t digest)
+{
+  uint8_t component[DIGEST_COMPONENT_SIZE] = {MARKER_DIGEST};
+  putLittleEndian(component + 1, digest);
+  name.append(component, sizeof(component));
 }
 
+template<typename Traits>
+bool
+BasicIBLT<Traits>::isDigestComponent(const ndn::name::Component& component)
+{
+  return component.value_size() == DIGEST_COMPONENT_SIZE && component.value()[0] == MARKER_DIGEST;
+}
+
+template<typename Traits>
+uint32_t
+BasicIBLT<Traits>::getDigestFromComponent(const ndn::name::Component& component)
+{
+  return getLittleEndian<uint32_t>(component.value() + 1);
+}
+
+#define PSYNC_INSTANTIATE_IBLT(nHash, Key, Count)                  \
+  template class BasicHashTableEntry<IBLTTraits<nHash, Key, Count>>; \
+  template class BasicIBLT<IBLTTraits<nHash, Key, Count>>
+
+PSYNC_INSTANTIATE_IBLT(3, uint32_t, int8_t);
+PSYNC_INSTANTIATE_IBLT(3, uint32_t, int16_t);
+PSYNC_INSTANTIATE_IBLT(3, uint32_t, int32_t);
+PSYNC_INSTANTIATE_IBLT(3, uint64_t, int8_t);
+PSYNC_INSTANTIATE_IBLT(3, uint64_t, int16_t);
+PSYNC_INSTANTIATE_IBLT(3, uint64_t, int32_t);
+PSYNC_INSTANTIATE_IBLT(4, uint32_t, int8_t);
+PSYNC_INSTANTIATE_IBLT(4, uint32_t, int16_t);
+PSYNC_INSTANTIATE_IBLT(4, uint32_t, int32_t);
+PSYNC_INSTANTIATE_IBLT(4, uint64_t, int8_t);
+PSYNC_INSTANTIATE_IBLT(4, uint64_t, int16_t);
+PSYNC_INSTANTIATE_IBLT(4, uint64_t, int32_t);
+
+#undef PSYNC_INSTANTIATE_IBLT
+
 } // namespace psync
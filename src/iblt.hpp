@@ -46,20 +46,99 @@
 #ifndef PSYNC_IBLT_HPP
 #define PSYNC_IBLT_HPP
 
+#include "simd.hpp"
+
 #include <ndn-cxx/name.hpp>
 
 #include <inttypes.h>
+#include <functional>
+#include <limits>
 #include <set>
 #include <vector>
 #include <string>
 
 namespace psync {
 
-class HashTableEntry
+/**
+ * @brief Compile-time layout of an IBLT
+ *
+ * @tparam NHash number of hash functions, i.e. cells touched per key
+ * @tparam Key type of the keys and of the keySum field, uint32_t or uint64_t
+ * @tparam Count type of the count field, int8_t, int16_t or int32_t
+ *
+ * Narrower counts shrink every cell on the wire, wider keys make collisions
+ * between prefix hashes less likely. keyCheck is always 32 bits.
+ * BasicIBLT is instantiated in iblt.cpp for NHash 3 or 4 and every
+ * combination of the key and count types above.
+ */
+template<size_t NHash, typename Key, typename Count>
+struct IBLTTraits
+{
+  static const size_t N_HASH = NHash;
+  // Seed of the check hash stored in keyCheck
+  static const size_t N_HASHCHECK = 11;
+
+  typedef Key KeyType;
+  typedef Count CountType;
+};
+
+typedef IBLTTraits<3, uint32_t, int32_t> DefaultIBLTTraits;
+
+/**
+ * @brief Encodings of the IBLT in a name, written as two components:
+ *        /<header>/<table>
+ */
+enum IBLTWireFormat {
+  /**
+   * header: size of the table in bytes, as a number component
+   * table: every cell as count, keySum and keyCheck, little-endian
+   */
+  IBLT_WIRE_PLAIN,
+  /**
+   * header: MARKER_IBLT_FORMAT, the format version (1) and the number of cells
+   *         (4 bytes LE)
+   * table: bitmap of the non-empty cells (bit i of byte i/8, LSB first), then
+   *        for each non-empty cell its zig-zag varint count and its keySum and
+   *        keyCheck little-endian. Empty cells cost one bit.
+   */
+  IBLT_WIRE_COMPACT
+};
+
+/* A third encoding, written by BasicIBLT::appendDeltaToName, only lists the
+ * cells that differ from an earlier table the receiver is expected to know:
+ *   header: MARKER_IBLT_FORMAT, version 2, digest of the base table (4 bytes LE)
+ *   table: for each differing cell, the gap from the previous one as a varint
+ *          followed by the cell as in IBLT_WIRE_COMPACT
+ */
+
+/**
+ * @brief Outcome of BasicIBLT::listEntries and BasicIBLT::listDifference
+ *
+ * PEEL_FAILED is zero, so the result still tests false when nothing was decoded.
+ */
+enum PeelResult {
+  /**
+   * The table could not be decoded, or the received one could not be subtracted
+   */
+  PEEL_FAILED = 0,
+  /**
+   * Every cell was peeled, the entries found are all of them
+   */
+  PEEL_COMPLETE,
+  /**
+   * The table holds more entries than the maxEntries found, or at least
+   * maxEntries entries and peeling got stuck: the entries found are only some
+   * of them, possibly none
+   */
+  PEEL_AT_BOUND
+};
+
+template<typename Traits>
+class BasicHashTableEntry
 {
 public:
-  int32_t count;
-  uint32_t keySum;
+  typename Traits::CountType count;
+  typename Traits::KeyType keySum;
   uint32_t keyCheck;
 
   bool isPure() const;
@@ -68,49 +147,377 @@ public:
 
 /* Invertible Bloom Lookup Table
  * https://github.com/gavinandresen/IBLT_Cplusplus
+ *
+ * Cells are stored as a struct of arrays (counts, keySums and keyChecks in
+ * separate aligned arrays) so that subtraction, comparison and the wire
+ * encoding run as vector kernels over whole arrays, see simd.hpp.
+ *
+ * The cells form N_HASH partitions, one per hash function, and a key goes to
+ * cell hash % partitionSize of each. A table therefore folds onto any smaller
+ * one whose partition size divides its own by adding up the cells that share
+ * a remainder, which gives the table the same keys would have built there.
+ * Tables of different sizes are compared by folding the larger one. To keep
+ * the sizes of a group foldable, give each node an expectedNumEntries of
+ * base * 2^k with the same base, a multiple of 2 * N_HASH.
  */
-class IBLT
+template<typename Traits>
+class BasicIBLT
 {
 public:
-  IBLT(size_t _expectedNumEntries);
-  IBLT(const IBLT& other);
-  IBLT(size_t _expectedNumEntries, std::vector <uint32_t> values);
+  typedef typename Traits::KeyType KeyType;
+  typedef typename Traits::CountType CountType;
+  typedef BasicHashTableEntry<Traits> HashTableEntry;
 
-  void insert(uint32_t key);
-  void erase(uint32_t key);
-  bool listEntries(std::set<uint32_t>& positive, std::set<uint32_t>& negative) const;
-  IBLT operator-(const IBLT& other) const;
-  bool operator==(const IBLT& other) const;
+  static const size_t N_HASH = Traits::N_HASH;
+  static const size_t N_HASHCHECK = Traits::N_HASHCHECK;
 
-  std::vector<HashTableEntry>
-  getHashTable() const
+  /**
+   * @brief Bytes per cell in the name component written by appendToName
+   */
+  static const size_t CELL_SIZE = sizeof(CountType) + sizeof(KeyType) + sizeof(uint32_t);
+
+  /**
+   * @brief Scratch space reused across calls to listEntries
+   *
+   * Holds the working copy of the table and the queue of pure cells so that
+   * repeated peeling does not allocate once the buffers have grown to size.
+   */
+  class PeelWorkspace
   {
-    return hashTable;
+  private:
+    simd::AlignedVector<CountType> count;
+    simd::AlignedVector<KeyType> keySum;
+    simd::AlignedVector<uint32_t> keyCheck;
+    std::vector<size_t> queue;
+
+    friend class BasicIBLT;
+  };
+
+  /**
+   * @brief Read-only view of the cells, valid until the table is changed or destroyed
+   */
+  struct CellView
+  {
+    const CountType* count;
+    const KeyType* keySum;
+    const uint32_t* keyCheck;
+    size_t size;
+  };
+
+  /**
+   * @brief Called with each peeled entry, @p isPositive if it is only in the
+   *        left-hand table of the difference
+   */
+  typedef std::function<void(KeyType key, bool isPositive)> EntryVisitor;
+
+  BasicIBLT(size_t _expectedNumEntries);
+  BasicIBLT(const BasicIBLT& other);
+  BasicIBLT(BasicIBLT&& other) = default;
+
+  BasicIBLT&
+  operator=(const BasicIBLT& other) = default;
+
+  BasicIBLT&
+  operator=(BasicIBLT&& other) = default;
+
+  /**
+   * @brief Construct from the table flattened into 32-bit words
+   *
+   * Each cell is one word of count, one word of keySum per 32 bits of key
+   * (low word first) and one word of keyCheck.
+   */
+  BasicIBLT(size_t _expectedNumEntries, std::vector <uint32_t> values);
+
+  void insert(KeyType key);
+  void erase(KeyType key);
+  bool listEntries(std::set<KeyType>& positive, std::set<KeyType>& negative) const;
+
+  /**
+   * @brief Peel the table into @p positive and @p negative using @p workspace
+   *
+   * Pure cells are queued once up front; after a key is removed only the cells
+   * it touched are re-examined, so the work is linear in the table size plus
+   * the number of entries recovered.
+   *
+   * With @p maxEntries, peeling stops as soon as that many entries are found
+   * (the result is still PEEL_COMPLETE if they were all of them), and a table that cannot be decoded is not reported as failed if
+   * estimateNumEntries already shows at least @p maxEntries entries. Either way
+   * the sets then only hold the entries peeled so far.
+   *
+   * @return PEEL_COMPLETE if every cell was peeled, PEEL_AT_BOUND if peeling
+   *         stopped because @p maxEntries entries are known to be in the table,
+   *         PEEL_FAILED if the table could not be decoded
+   */
+  PeelResult listEntries(std::set<KeyType>& positive, std::set<KeyType>& negative,
+                         PeelWorkspace& workspace,
+                         size_t maxEntries = std::numeric_limits<size_t>::max()) const;
+
+  /**
+   * @brief Same as above, appending the entries to @p positive and @p negative
+   *
+   * Vectors cleared and reused by the caller do not allocate once grown to size.
+   */
+  PeelResult listEntries(std::vector<KeyType>& positive, std::vector<KeyType>& negative,
+                         PeelWorkspace& workspace,
+                         size_t maxEntries = std::numeric_limits<size_t>::max()) const;
+
+  /**
+   * @brief Same as above, handing each entry to @p visitor as it is peeled
+   */
+  PeelResult listEntries(const EntryVisitor& visitor, PeelWorkspace& workspace,
+                         size_t maxEntries = std::numeric_limits<size_t>::max()) const;
+
+  /**
+   * @brief Peel the difference between this table and the one in @p ibltName
+   *
+   * Equivalent to (*this - getIBLTFromName(...)).listEntries(...), but the
+   * received cells are decoded and subtracted from ours in one pass straight
+   * into @p workspace: no IBLT is built and nothing is allocated once the
+   * workspace has grown to size. In the compact format only the non-empty
+   * received cells are visited.
+   *
+   * @param ibltHeader, ibltName IBF components of a sync interest, as written by appendToName
+   * @param maxEntries stop once that many differences are known, see listEntries
+   * @return PEEL_FAILED as well if they do not hold a table we can subtract,
+   *         or hold a delta
+   */
+  PeelResult listDifference(const ndn::name::Component& ibltHeader,
+                            const ndn::name::Component& ibltName,
+                            std::set<KeyType>& positive, std::set<KeyType>& negative,
+                            PeelWorkspace& workspace,
+                            size_t maxEntries = std::numeric_limits<size_t>::max()) const;
+
+  /**
+   * @brief Peel the difference between this table and @p other, computed
+   *        straight into @p workspace instead of into a new IBLT
+   *
+   * If the sizes differ, the larger table is folded onto the smaller one.
+   * @return PEEL_FAILED as well if neither folds onto the other
+   */
+  PeelResult listDifference(const BasicIBLT& other,
+                            std::set<KeyType>& positive, std::set<KeyType>& negative,
+                            PeelWorkspace& workspace,
+                            size_t maxEntries = std::numeric_limits<size_t>::max()) const;
+
+  PeelResult listDifference(const BasicIBLT& other,
+                            std::vector<KeyType>& positive, std::vector<KeyType>& negative,
+                            PeelWorkspace& workspace,
+                            size_t maxEntries = std::numeric_limits<size_t>::max()) const;
+
+  PeelResult listDifference(const BasicIBLT& other, const EntryVisitor& visitor,
+                            PeelWorkspace& workspace,
+                            size_t maxEntries = std::numeric_limits<size_t>::max()) const;
+
+  /**
+   * @brief Lower bound on the number of entries, without peeling
+   *
+   * Every entry adds or removes one in N_HASH cells, so the entries number at
+   * least the sum of |count| over N_HASH, and at least the number of non-empty
+   * cells over N_HASH. Exact when no two entries share a cell. On a difference
+   * table this bounds the size of the difference.
+   */
+  size_t
+  estimateNumEntries() const;
+
+  /**
+   * @brief Difference of the two tables, in the size of the smaller one if
+   *        the larger one folds onto it
+   */
+  BasicIBLT operator-(const BasicIBLT& other) const;
+  bool operator==(const BasicIBLT& other) const;
+
+  /**
+   * @brief Returns true if every cell of the table is zero
+   */
+  bool
+  empty() const;
+
+  CellView
+  getCells() const
+  {
+    return {m_count.data(), m_keySum.data(), m_keyCheck.data(), m_count.size()};
   }
 
+  /**
+   * @brief Returns a copy of the cells, for debugging and tests
+   */
+  std::vector<HashTableEntry>
+  getHashTable() const;
+
   std::size_t
   getNumEntry() {
-    return hashTable.size();
+    return m_count.size();
   }
 
+  /**
+   * @brief Append the table to @p name as /<header>/<table>, see IBLTWireFormat
+   *
+   * The two components are encoded on the first call after a change to the
+   * table and shared by later calls in the same format, which only copy a
+   * reference to their buffer.
+   */
   void
-  appendToName(ndn::Name& name) const;
+  appendToName(ndn::Name& name, IBLTWireFormat format = IBLT_WIRE_COMPACT) const;
 
-  IBLT
-  getIBLTFromName(size_t expectedNumEntries, size_t ibltSize,
+  /**
+   * @brief Counter bumped by every change to the cells
+   */
+  uint64_t
+  getVersion() const
+  {
+    return m_version;
+  }
+
+  /**
+   * @brief Decode the table appended to a name in the plain or compact format
+   *
+   * The table keeps the size it was sent with, which may differ from ours.
+   *
+   * @param ibltHeader second to last IBF component, selects the format
+   * @param ibltName last IBF component, the table itself
+   * @throws std::invalid_argument if canReadFromName is false, or the compact
+   *         table is malformed
+   */
+  BasicIBLT
+  getIBLTFromName(const ndn::name::Component& ibltHeader,
+                  const ndn::name::Component& ibltName) const;
+
+  /**
+   * @brief Check the size of a received table before anything is allocated for it
+   *
+   * The number of cells comes from the peer, so tables of more than
+   * MAX_RECEIVED_FOLD times our own cells are refused, as are compact headers
+   * whose table is too short to hold even the bitmap of their cells.
+   *
+   * @return false if the components hold a delta, a table of a size we refuse,
+   *         or one that neither folds onto ours nor ours onto it
+   */
+  bool
+  canReadFromName(const ndn::name::Component& ibltHeader,
                   const ndn::name::Component& ibltName) const;
 
+  /**
+   * @brief Received tables may have up to that many times our cells
+   */
+  static const size_t MAX_RECEIVED_FOLD = 16;
+
+  /**
+   * @brief Returns true if the table folds onto one of @p numCells cells
+   */
+  bool
+  canFoldTo(size_t numCells) const;
+
+  /**
+   * @brief The table with the same keys in @p numCells cells
+   *
+   * @throws std::invalid_argument if !canFoldTo(numCells)
+   */
+  BasicIBLT
+  fold(size_t numCells) const;
+
+  /**
+   * @brief Append only the cells that differ from @p base, see IBLTWireFormat
+   *
+   * The receiver rebuilds the table with applyDelta on its own copy of @p base,
+   * which it looks up by getDeltaBase.
+   */
+  void
+  appendDeltaToName(ndn::Name& name, const BasicIBLT& base) const;
+
+  static bool
+  isDeltaHeader(const ndn::name::Component& ibltHeader);
+
+  /**
+   * @brief Digest of the base table named by a delta header
+   */
+  static uint32_t
+  getDeltaBase(const ndn::name::Component& ibltHeader);
+
+  /**
+   * @brief Overwrite the cells listed in the delta table @p ibltName,
+   *        *this being its base
+   *
+   * @return false if the table is malformed, *this is then unspecified
+   */
+  bool
+  applyDelta(const ndn::name::Component& ibltName);
+
+  /**
+   * @brief 32-bit digest of the cells, equal tables have equal digests
+   */
+  uint32_t
+  getDigest() const;
+
+  /**
+   * @brief Append @p digest, as returned by getDigest, as a MARKER_DIGEST component
+   *
+   * Sent ahead of the table so that a peer with the same digest can skip decoding it.
+   */
+  static void
+  appendDigestToName(ndn::Name& name, uint32_t digest);
+
+  static bool
+  isDigestComponent(const ndn::name::Component& component);
+
+  static uint32_t
+  getDigestFromComponent(const ndn::name::Component& component);
+
 public:
   // for debugging
   std::string DumpTable() const;
 
 private:
-  void _insert(int plusOrMinus, uint32_t key);
+  void _insert(int plusOrMinus, KeyType key);
+
+  void
+  copyInto(PeelWorkspace& workspace) const;
+
+  /**
+   * @brief Put this table minus the received one into @p workspace
+   * @return false if the received table is malformed or cannot be compared with ours
+   */
+  bool
+  subtractInto(const ndn::name::Component& ibltHeader, const ndn::name::Component& ibltName,
+               PeelWorkspace& workspace) const;
+
+  bool
+  subtractInto(const BasicIBLT& other, PeelWorkspace& workspace) const;
+
+  /**
+   * @brief Number of cells of the table in @p ibltHeader, @p ibltName
+   * @return false if it is a delta or canReadFromName does not accept its size
+   */
+  bool
+  getReceivedNumCells(const ndn::name::Component& ibltHeader,
+                      const ndn::name::Component& ibltName, size_t& numCells) const;
+
+  /**
+   * @brief Peel the table already in @p workspace, calling @p onEntry(key, isPositive)
+   *        for each entry
+   */
+  template<typename OnEntry>
+  static PeelResult
+  peel(PeelWorkspace& workspace, size_t maxEntries, const OnEntry& onEntry);
 
 private:
-  std::vector<HashTableEntry> hashTable;
+  simd::AlignedVector<CountType> m_count;
+  simd::AlignedVector<KeyType> m_keySum;
+  simd::AlignedVector<uint32_t> m_keyCheck;
+
+  uint64_t m_version;
+  // Components of the last appendToName, valid while m_cachedVersion == m_version
+  mutable uint64_t m_cachedVersion;
+  mutable IBLTWireFormat m_cachedFormat;
+  mutable ndn::name::Component m_cachedHeader;
+  mutable ndn::name::Component m_cachedTable;
 };
 
+typedef BasicHashTableEntry<DefaultIBLTTraits> HashTableEntry;
+typedef BasicIBLT<DefaultIBLTTraits> IBLT;
+
+extern template class BasicHashTableEntry<DefaultIBLTTraits>;
+extern template class BasicIBLT<DefaultIBLTTraits>;
+
 } // namespace psync
 
-#endif // PSYNC_IBLT_HPP
\ No newline at end of file
+#endif // PSYNC_IBLT_HPP
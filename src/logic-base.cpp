@@ -31,16 +31,15 @@ namespace psync {
 
 _LOG_INIT(LogicBase);
 
-// Why is this fixed, it is hash seed for murmur hash
-static const size_t N_HASHCHECK = 11;
-
 LogicBase::LogicBase(size_t expectedNumEntries,
                      ndn::Face& face,
                      const ndn::Name& syncPrefix,
                      const ndn::Name& userPrefix)
   : m_iblt(expectedNumEntries)
+  , m_ibltDigest(m_iblt.getDigest())
   , m_expectedNumEntries(expectedNumEntries)
   , m_threshold(expectedNumEntries/2)
+  , m_isFullStateContentCurrent(false)
   , m_face(face)
   , m_scheduler(m_face.getIoService())
   , m_syncPrefix(syncPrefix)
@@ -67,14 +66,24 @@ LogicBase::addSyncNode(const std::string& prefix)
 void
 LogicBase::removeSyncNode(const std::string& prefix)
 {
-  if (m_prefixes.find(prefix) != m_prefixes.end()) {
-    uint32_t seqNo = m_prefixes[prefix];
-    m_prefixes.erase(prefix);
-    std::string prefixWithSeq = prefix + "/" + std::to_string(seqNo);
-    uint32_t hash = m_prefix2hash[prefixWithSeq];
-    m_prefix2hash.erase(prefixWithSeq);
-    m_hash2prefix.erase(hash);
-    m_iblt.erase(hash);
+  auto it = m_prefixes.find(prefix);
+  if (it != m_prefixes.end()) {
+    uint32_t seqNo = it->second;
+    m_prefixes.erase(it);
+    // Sequence number zero is not in the IBF
+    if (seqNo != 0) {
+      uint32_t hash = getPrefixHash(prefix, seqNo);
+      m_isFullStateContentCurrent = false;
+      m_hash2prefix.erase(hash);
+      m_iblt.erase(hash);
+      m_ibltDigest = m_iblt.getDigest();
+      m_estimator.erase(hash);
+      m_rateless.erase(hash);
+    }
+  }
+
+  if (m_estimator.needsRebuild()) {
+    rebuildEstimator();
   }
 }
 
@@ -90,21 +99,97 @@ LogicBase::updateSeq(const std::string& prefix, uint32_t seq)
   // Delete the last sequence prefix from the iblt
   // Because we don't insert zeroth prefix in IBF so no need to delete that
   if (m_prefixes.find(prefix) != m_prefixes.end() && m_prefixes[prefix] != 0) {
-    uint32_t hash = m_prefix2hash[prefix + "/" + std::to_string(m_prefixes[prefix])];
-    m_prefix2hash.erase(prefix + "/" + std::to_string(m_prefixes[prefix]));
+    uint32_t hash = getPrefixHash(prefix, m_prefixes[prefix]);
     m_hash2prefix.erase(hash);
     m_iblt.erase(hash);
+    m_estimator.erase(hash);
+    m_rateless.erase(hash);
   }
 
   // Insert the new seq no
-  m_prefixes[prefix] = seq;
-  std::string prefixWithSeq = prefix + "/" + std::to_string(m_prefixes[prefix]);
-  uint32_t newHash = MurmurHash3(N_HASHCHECK, ParseHex(prefixWithSeq));
-  m_prefix2hash[prefixWithSeq] = newHash;
-  m_hash2prefix[newHash] = prefix;
+  m_isFullStateContentCurrent = false;
+  auto it = m_prefixes.insert(std::make_pair(prefix, seq)).first;
+  it->second = seq;
+  uint32_t newHash = getPrefixHash(prefix, seq);
+  m_hash2prefix[newHash] = it;
   m_iblt.insert(newHash);
+  m_ibltDigest = m_iblt.getDigest();
+  m_estimator.insert(newHash);
+  m_rateless.insert(newHash);
+
+  if (m_estimator.needsRebuild()) {
+    rebuildEstimator();
+  }
+}
+
+uint32_t
+LogicBase::getPrefixHash(const std::string& prefix, uint32_t seq)
+{
+  return MurmurHash3(IBLT::N_HASHCHECK, ParseHex(prefix + "/" + std::to_string(seq)));
+}
+
+void
+LogicBase::rebuildEstimator()
+{
+  _LOG_DEBUG("Rebuilding difference estimator");
+  m_estimator.clear();
+  for (const auto& prefixAndSeq : m_prefixes) {
+    if (prefixAndSeq.second != 0) {
+      m_estimator.insert(getPrefixHash(prefixAndSeq.first, prefixAndSeq.second));
+    }
+  }
+}
+
+const std::string&
+LogicBase::getFullStateContent()
+{
+  return psync::getFullStateContent(m_prefixes, m_fullStateContent, m_isFullStateContentCurrent);
+}
+
+std::string
+LogicBase::getFullStateContent(Subscription& subscription)
+{
+  return psync::getFullStateContent(m_prefixes, m_fullStateContent, m_isFullStateContentCurrent,
+                                    subscription);
+}
+
+template<typename Hashes>
+std::string
+LogicBase::getContent(const Hashes& hashes)
+{
+  std::string content;
+  for (const auto& hash : hashes) {
+    auto it = m_hash2prefix.find(hash);
+    if (it != m_hash2prefix.end()) {
+      content += it->second->first + " " + std::to_string(it->second->second) + "\n";
+    }
+  }
+  return content;
+}
+
+template<typename Hashes>
+std::string
+LogicBase::getContent(const Hashes& hashes, Subscription& subscription)
+{
+  if (subscription.isSubscribeAll) {
+    return getContent(hashes);
+  }
+
+  std::string content;
+  for (const auto& hash : hashes) {
+    auto it = m_hash2prefix.find(hash);
+    if (it != m_hash2prefix.end() && subscription.contains(it->second->first)) {
+      content += it->second->first + " " + std::to_string(it->second->second) + "\n";
+    }
+  }
+  return content;
 }
 
+template std::string LogicBase::getContent(const std::set<uint32_t>&);
+template std::string LogicBase::getContent(const std::vector<uint32_t>&);
+template std::string LogicBase::getContent(const std::set<uint32_t>&, Subscription&);
+template std::string LogicBase::getContent(const std::vector<uint32_t>&, Subscription&);
+
 void
 LogicBase::sendApplicationNack(const ndn::Interest& interest)
 {
@@ -21,10 +21,14 @@
 #define PSYNC_LOGIC_BASE_HPP
 
 #include "iblt.hpp"
+#include "difference-estimator.hpp"
+#include "rateless-iblt.hpp"
 #include "bloom-filter.hpp"
+#include "sync-interest.hpp"
 #include "util.hpp"
 
 #include <map>
+#include <unordered_map>
 #include <unordered_set>
 #include <random>
 
@@ -66,7 +70,7 @@ protected:
    *
    * We remove already existing prefix/seq from IBF
    * (unless seq is zero because we don't insert zero seq into IBF)
-   * Then we update m_prefix, m_prefix2hash, m_hash2prefix, and IBF
+   * Then we update m_prefix, m_hash2prefix, IBF and its digest
    *
    * @param prefix prefix of the update
    * @param seq sequence number of the update
@@ -86,6 +90,50 @@ protected:
     return m_prefixes[prefix];
   }
 
+  /**
+   * @brief Key of @p prefix with sequence number @p seq in the IBF
+   */
+  static uint32_t
+  getPrefixHash(const std::string& prefix, uint32_t seq);
+
+  /**
+   * @brief Refill m_estimator from m_prefixes after erasures depleted its sketch
+   */
+  void
+  rebuildEstimator();
+
+  /**
+   * @brief Sync reply content listing every prefix with a non-zero sequence number
+   *
+   * Sent when the difference with a peer could not be peeled from the IBF.
+   * Built once and shared by every peer until a sequence number changes.
+   */
+  const std::string&
+  getFullStateContent();
+
+  /**
+   * @brief Same as getFullStateContent, restricted to the prefixes in @p subscription
+   */
+  std::string
+  getFullStateContent(Subscription& subscription);
+
+  /**
+   * @brief Sync reply content listing the prefixes whose current prefix/seq
+   *        hashes to one of @p hashes, e.g. the positive side of a difference
+   *
+   * @tparam Hashes std::set or std::vector of uint32_t
+   */
+  template<typename Hashes>
+  std::string
+  getContent(const Hashes& hashes);
+
+  /**
+   * @brief Same as getContent, restricted to the prefixes in @p subscription
+   */
+  template<typename Hashes>
+  std::string
+  getContent(const Hashes& hashes, Subscription& subscription);
+
   void
   sendApplicationNack(const ndn::Interest& interest);
 
@@ -97,12 +145,25 @@ protected:
 
 protected:
   IBLT m_iblt;
+  // m_iblt.getDigest(), peers sending the same digest are in sync with us
+  uint32_t m_ibltDigest;
+  // reused by every diff.listEntries so peeling does not allocate per interest
+  IBLT::PeelWorkspace m_peelWorkspace;
+  // sketch of the hashes in m_iblt, tells how far a peer is before peeling
+  DifferenceEstimator m_estimator;
+  // same hashes again, coded so that a failed peel can be retried with more symbols
+  RatelessIBLT m_rateless;
   uint32_t m_expectedNumEntries;
   uint32_t m_threshold;
 
   std::map <std::string, uint32_t> m_prefixes; // prefix and sequence number
-  std::map <std::string, uint32_t> m_prefix2hash;
-  std::map <uint32_t, std::string> m_hash2prefix;
+  // IBF key of each prefix with a non-zero sequence number -> its entry in m_prefixes,
+  // which holds both what a reply needs. The key of an entry is recomputed with
+  // getPrefixHash rather than kept in a second map
+  std::unordered_map <uint32_t, std::map <std::string, uint32_t>::iterator> m_hash2prefix;
+  // getFullStateContent, valid while m_isFullStateContentCurrent
+  std::string m_fullStateContent;
+  bool m_isFullStateContentCurrent;
 
   ndn::Face& m_face;
   ndn::KeyChain m_keyChain;
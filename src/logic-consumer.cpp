@@ -19,6 +19,7 @@
 
 #include "logic-consumer.hpp"
 #include "logging.hpp"
+#include "sync-interest.hpp"
 
 #include <ndn-cxx/util/time.hpp>
 #include <ctime>
@@ -34,24 +35,22 @@ LogicConsumer::LogicConsumer(ndn::Name& prefix,
                              RecieveHelloCallback& onRecieveHelloData,
                              UpdateCallback& onUpdate,
                              unsigned int count,
-                             double false_positve)
+                             double false_positve,
+                             bloom_filter_type bloomFilterType)
 : m_syncPrefix(prefix)
 , m_face(face)
 , m_onRecieveHelloData(onRecieveHelloData)
 , m_onUpdate(onUpdate)
 , m_count(count)
 , m_false_positive(false_positve)
-, m_suball(false_positve == 0.001 && m_count == 1)  //subscribe to all data streams - a hack
+, m_bloomFilterType(bloomFilterType)
+, m_suball(false_positve == 0.001 && m_count == 1)  //subscribe to all data streams, kept for callers from before setSubscribeAll
 , m_helloSent(false)
 , m_scheduler(m_face.getIoService())
 , m_randomGenerator(static_cast<unsigned int>(std::time(0)))
 , m_rangeUniformRandom(m_randomGenerator, boost::uniform_int<>(100,500))
 {
-  bloom_parameters opt;
-  opt.false_positive_probability = m_false_positive;
-  opt.projected_element_count = m_count;
-  opt.compute_optimal_parameters();
-  m_bf = bloom_filter(opt);
+  resetBF();
 }
 
 LogicConsumer::~LogicConsumer()
@@ -92,7 +91,7 @@ LogicConsumer::onHelloData(const ndn::Interest& interest, const ndn::Data& data)
 
   _LOG_DEBUG("On Hello Data " << helloDataName);
 
-  m_iblt = helloDataName.getSubName(helloDataName.size()-2, 2);
+  setIBLT(interest, helloDataName);
   _LOG_DEBUG("m_iblt: " << m_iblt);
   std::string content(reinterpret_cast<const char*>(data.getContent().value()),
                         data.getContent().value_size());
@@ -105,7 +104,7 @@ LogicConsumer::onHelloData(const ndn::Interest& interest, const ndn::Data& data)
 void
 LogicConsumer::sendSyncInterest()
 {
-  // Sync interest format for partial: /<sync-prefix>/sync/<BF>/<old-IBF>
+  // Sync interest format for partial: /<sync-prefix>/sync/<old-IBF-digest>/<subtrees>?/<BF or subscribe-all>/<old-IBF>
   // Sync interest format for full: /<sync-prefix>/sync/full/<old-IBF>?
 
   // name last component is the IBF and content should be the prefix with the version numbers
@@ -115,8 +114,20 @@ LogicConsumer::sendSyncInterest()
   ndn::Name syncInterestName = m_syncPrefix;
   syncInterestName.append("sync");
 
+  // Lets a producer still in that state skip decoding the IBF, placed before
+  // the subscription list so that producers parsing from the end ignore it
+  syncInterestName.append(m_ibltDigest);
+
   // Append subscription list
-  appendBF(syncInterestName);
+  if (m_suball) {
+    appendSubscribeAllToName(syncInterestName);
+  }
+  else {
+    if (!m_subtrees.empty()) {
+      appendSubtreesToName(syncInterestName, m_subtrees);
+    }
+    appendBF(syncInterestName);
+  }
 
   // Append IBF received in hello/sync data
   syncInterestName.append(m_iblt);
@@ -149,7 +160,7 @@ LogicConsumer::onSyncData(const ndn::Interest& interest, const ndn::Data& data)
 
   _LOG_DEBUG("On Sync Data ");
 
-  m_iblt = syncDataName.getSubName(syncDataName.size()-2, 2);
+  setIBLT(interest, syncDataName);
 
   std::string content(reinterpret_cast<const char*>(data.getContent().value()),
                         data.getContent().value_size());
@@ -257,8 +268,75 @@ void
 LogicConsumer::addSL(std::string s)
 {
   m_prefixes[s] = 0;
-  m_sl.insert(s);
-  m_bf.insert(s);
+  // counted once, so that a single removeSL takes it out
+  if (!m_sl.insert(s).second) {
+    return;
+  }
+
+  if (m_bloomFilterType != bloom_filter_cuckoo) {
+    m_bf.insert(s);
+    return;
+  }
+
+  // A full cuckoo filter is rebuilt for twice as many prefixes, the count
+  // sent in the sync interest lets producers size it the same way
+  bool isInserted = m_cuckoo.insert(s);
+  while (!isInserted) {
+    _LOG_DEBUG("Subscription filter full at " << m_sl.size() - 1 << " prefixes, resizing");
+    m_count *= 2;
+    resetBF();
+    isInserted = true;
+    for (const std::string& prefix : m_sl) {
+      if (!m_cuckoo.insert(prefix)) {
+        isInserted = false;
+        break;
+      }
+    }
+  }
+}
+
+void
+LogicConsumer::removeSL(const std::string& s)
+{
+  if (m_sl.erase(s) == 0) {
+    return;
+  }
+  m_prefixes.erase(s);
+  if (m_bloomFilterType == bloom_filter_cuckoo) {
+    m_cuckoo.remove(s);
+  }
+  else {
+    m_bf.remove(s);
+  }
+}
+
+void
+LogicConsumer::addSubtree(const std::string& prefix)
+{
+  m_subtrees.insert(prefix);
+}
+
+void
+LogicConsumer::removeSubtree(const std::string& prefix)
+{
+  m_subtrees.erase(prefix);
+}
+
+std::set <std::string>
+LogicConsumer::getSubtrees()
+{
+  return m_subtrees;
+}
+
+bool
+LogicConsumer::isInSubtree(const std::string& prefix)
+{
+  for (const std::string& subtree : m_subtrees) {
+    if (NameTrie::isPrefixOf(subtree, prefix)) {
+      return true;
+    }
+  }
+  return false;
 }
 
 std::vector <std::string>
@@ -271,9 +349,54 @@ void
 LogicConsumer::appendBF(ndn::Name& name)
 {
   name.appendNumber(m_count);
-  name.appendNumber((int)(m_false_positive*1000));
-  name.appendNumber(m_bf.getTableSize());
-  name.append(m_bf.begin(), m_bf.end());
+  name.appendNumber(encode_false_positive(m_false_positive, m_bloomFilterType));
+  if (m_bloomFilterType == bloom_filter_cuckoo) {
+    name.appendNumber(m_cuckoo.getTableSize());
+    name.append(m_cuckoo.table().begin(), m_cuckoo.table().end());
+  }
+  else {
+    // Few subscriptions in a large filter leave it mostly zeros, which
+    // compresses well. The size component is that of the raw table either way.
+    compress_bloom_table(&*m_bf.begin(), m_bf.getTableSize(), m_compressedBF);
+    name.appendNumber(m_bf.getTableSize());
+    if (m_compressedBF.size() < m_bf.getTableSize()) {
+      name.append(m_compressedBF.data(), m_compressedBF.size());
+    }
+    else {
+      name.append(m_bf.begin(), m_bf.end());
+    }
+  }
+}
+
+void
+LogicConsumer::resetBF()
+{
+  // sized for the rate producers read back from the false positive component,
+  // which may be rounded
+  bloom_parameters opt;
+  decode_false_positive(encode_false_positive(m_false_positive, m_bloomFilterType), opt);
+  opt.projected_element_count = m_count;
+  opt.compute_optimal_parameters();
+  if (m_bloomFilterType == bloom_filter_cuckoo) {
+    m_cuckoo = cuckoo_filter(opt);
+  }
+  else {
+    m_bf = counting_bloom_filter(opt);
+  }
+}
+
+void
+LogicConsumer::setIBLT(const ndn::Interest& interest, const ndn::Name& dataName)
+{
+  m_iblt = dataName.getSubName(dataName.size()-2, 2);
+
+  m_ibltDigest = ndn::Name();
+  for (size_t i = interest.getName().size(); i < dataName.size(); i++) {
+    if (IBLT::isDigestComponent(dataName.get(i))) {
+      m_ibltDigest.append(dataName.get(i));
+      break;
+    }
+  }
 }
 
 void
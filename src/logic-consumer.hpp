@@ -21,6 +21,9 @@
 #define PSYNC_LOGIC_CONSUMER_HPP
 
 #include "bloom-filter.hpp"
+#include "cuckoo-filter.hpp"
+#include "iblt.hpp"
+#include "name-trie.hpp"
 #include "util.hpp"
 
 #include <ndn-cxx/face.hpp>
@@ -42,12 +45,15 @@ class LogicConsumer
 {
 public:
   //false_positive: false_positive probability
+  //bloomFilterType: any other type than bloom_filter_salted can only be read
+  //by producers that decode it from the false positive component
   LogicConsumer(ndn::Name& prefix,
                 ndn::Face& face,
                 RecieveHelloCallback& onRecieveHelloData,
                 UpdateCallback& onUpdate,
                 unsigned int count,
-                double false_postive);
+                double false_postive,
+                bloom_filter_type bloomFilterType = bloom_filter_salted);
 
   ~LogicConsumer();
 
@@ -61,9 +67,38 @@ public:
   bool haveSentHello();
   std::set <std::string> getSL();
   void addSL(std::string s);
+
+  /**
+   * @brief Unsubscribe from @p s, taking effect with the next sync interest
+   *
+   * No new hello interest is needed, the producer's IBF is kept.
+   */
+  void removeSL(const std::string& s);
+
+  /**
+   * @brief Subscribe to every prefix under @p prefix, component by component,
+   *        including the ones producers add later
+   *
+   * Sent as is in sync interests rather than in the Bloom filter, so their
+   * size does not grow with the number of prefixes covered.
+   */
+  void addSubtree(const std::string& prefix);
+  void removeSubtree(const std::string& prefix);
+  std::set <std::string> getSubtrees();
   std::vector <std::string> getNS();
+
+  /**
+   * @brief Subscribe to every prefix, or go back to the subscription list
+   *
+   * Sync interests then carry a subscribe-all marker in place of the
+   * subscription list, and producers send everything without a filter.
+   */
+  void setSubscribeAll(bool isSubscribeAll) {
+    m_suball = isSubscribeAll;
+  }
+
   bool isSub(std::string prefix) {
-    return m_suball || m_sl.find(prefix) != m_sl.end();
+    return m_suball || m_sl.find(prefix) != m_sl.end() || isInSubtree(prefix);
   }
 
   void setSeq(std::string prefix, const uint32_t& seq) {
@@ -86,6 +121,19 @@ private:
   void onDataNack(const ndn::Interest& interest, const ndn::lp::Nack& nack, int nRetries,
                   const FetchDataCallBack& fdCallback);
   void appendBF(ndn::Name& name);
+  bool isInSubtree(const std::string& prefix);
+
+  /**
+   * @brief Make an empty subscription filter of m_bloomFilterType for m_count
+   *        prefixes
+   */
+  void resetBF();
+
+  /**
+   * @brief Keep the producer's IBF and its digest from the name of hello or sync
+   *        data answering @p interest
+   */
+  void setIBLT(const ndn::Interest& interest, const ndn::Name& dataName);
   void onNackForHello(const ndn::Interest& interest, const ndn::lp::Nack& nack);
   void onNackForSync(const ndn::Interest& interest, const ndn::lp::Nack& nack);
 
@@ -96,13 +144,21 @@ private:
   UpdateCallback m_onUpdate;
   unsigned int m_count;
   double m_false_positive;
+  bloom_filter_type m_bloomFilterType;
   bool m_suball;
   ndn::Name m_iblt;
+  // digest component sent along with m_iblt, empty if the producer sent none
+  ndn::Name m_ibltDigest;
   std::map <std::string, uint32_t> m_prefixes;
   bool m_helloSent;
   std::set <std::string> m_sl;
+  std::set <std::string> m_subtrees;
   std::vector <std::string> m_ns;
-  bloom_filter m_bf;
+  counting_bloom_filter m_bf;
+  // subscription list instead of m_bf with bloom_filter_cuckoo
+  cuckoo_filter m_cuckoo;
+  // m_bf as compress_bloom_table encodes it, kept to reuse the buffer
+  std::vector <uint8_t> m_compressedBF;
   const ndn::PendingInterestId* m_outstandingInterestId;
   ndn::Scheduler m_scheduler;
 
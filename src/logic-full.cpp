@@ -25,14 +25,74 @@
 #include <iostream>
 #include <cstring>
 #include <limits>
+#include <algorithm>
 #include <functional>
 
 namespace psync {
 
 _LOG_INIT(LogicFull);
 
-// Why is this fixed, it is hash seed for murmur hash
-static const size_t N_HASHCHECK = 11;
+// Symbols per symbol reply, 6 KB of content
+static const size_t MAX_SYMBOLS_PER_DATA = 512;
+// Symbols we materialize for a single state before giving up
+static const size_t MAX_RATELESS_SYMBOLS = 1 << 16;
+
+// States kept to rebuild delta IBFs from
+static const size_t MAX_RECENT_IBLTS = 8;
+// Every that many sync interests carries the full IBF, so that peers which
+// missed our earlier states catch up
+static const size_t FULL_IBLT_INTERVAL = 8;
+
+// Room left in a sync reply for the signature and the Data TLV headers
+static const size_t SYNC_DATA_OVERHEAD = 512;
+
+/**
+ * @brief Length of the longest run of whole lines at the start of @p content
+ *        that a sync reply named @p name can carry in one packet
+ */
+static size_t
+getFittingLength(const ndn::Name& name, const std::string& content)
+{
+  size_t used = name.wireEncode().size() + SYNC_DATA_OVERHEAD;
+  if (used >= ndn::MAX_NDN_PACKET_SIZE) {
+    return 0;
+  }
+  size_t budget = ndn::MAX_NDN_PACKET_SIZE - used;
+  if (content.size() <= budget) {
+    return content.size();
+  }
+  size_t lineEnd = content.rfind('\n', budget - 1);
+  return lineEnd == std::string::npos ? 0 : lineEnd + 1;
+}
+
+static void
+putUint32(uint8_t* out, uint32_t value)
+{
+  for (size_t b = 0; b < 4; b++) {
+    out[b] = static_cast<uint8_t>(value >> (8 * b));
+  }
+}
+
+static uint32_t
+getUint32(const uint8_t* in)
+{
+  return in[0] | (in[1] << 8) | (in[2] << 16) | (static_cast<uint32_t>(in[3]) << 24);
+}
+
+// MARKER_RATELESS, digest, first symbol, number of symbols
+static const size_t SYMBOL_REQUEST_SIZE = 13;
+
+static bool
+isSymbolRequest(const ndn::name::Component& component)
+{
+  return component.value_size() == SYMBOL_REQUEST_SIZE && component.value()[0] == MARKER_RATELESS;
+}
+
+static bool
+isSymbolReply(const ndn::name::Component& component)
+{
+  return component.value_size() == 1 && component.value()[0] == MARKER_RATELESS;
+}
 
 LogicFull::LogicFull(const size_t expectedNumEntries,
                      ndn::Face& face,
@@ -47,6 +107,8 @@ LogicFull::LogicFull(const size_t expectedNumEntries,
   , m_onUpdate(onUpdateCallBack)
   , m_outstandingInterestId(0)
   , m_jitter(-200, 200)
+  , m_lastSentDigest(0)
+  , m_numDeltaInterests(FULL_IBLT_INTERVAL)
 {
   _LOG_DEBUG("m_threshold " << m_threshold);
   addSyncNode(m_userPrefix.toUri());
@@ -73,6 +135,7 @@ LogicFull::publishName(const std::string& prefix)
   _LOG_INFO("Publish: "<< prefix << "/" << newSeq);
 
   updateSeq(prefix, newSeq);
+  rememberIBLT();
 
   satisfyPendingInterests();
 }
@@ -87,11 +150,27 @@ LogicFull::sendSyncInterest()
     m_face.removePendingInterest(m_outstandingInterestId);
   }
 
-  // Sync Interest format for full sync: /<sync-prefix>/<ourLatestIBF>
+  // Sync Interest format for full sync: /<sync-prefix>/<digest>/<estimator>/<ourLatestIBF>
   ndn::Name syncInterestName = m_syncPrefix;
 
-  // Append our latest IBF
-  m_iblt.appendToName(syncInterestName);
+  // Peers in the same state skip decoding our IBF
+  IBLT::appendDigestToName(syncInterestName, m_ibltDigest);
+
+  // Older peers read the IBF from the end and skip the estimator
+  m_estimator.appendToName(syncInterestName);
+
+  // Append our latest IBF, as a delta if peers are likely to have the last one
+  rememberIBLT();
+  const IBLT* lastSent = findRecentIBLT(m_lastSentDigest);
+  if (lastSent != nullptr && m_numDeltaInterests < FULL_IBLT_INTERVAL) {
+    m_iblt.appendDeltaToName(syncInterestName, *lastSent);
+    m_numDeltaInterests++;
+  }
+  else {
+    m_iblt.appendToName(syncInterestName);
+    m_numDeltaInterests = 0;
+  }
+  m_lastSentDigest = m_recentIBLTs.back().first;
 
   m_outstandingInterestName = syncInterestName;
 
@@ -133,51 +212,129 @@ LogicFull::onSyncInterest(const ndn::Name& prefixName, const ndn::Interest& inte
 
   // parse IBF
   ndn::Name interestName = interest.getName();
-  size_t ibltSize = interestName.get(interestName.size()-2).toNumber();
+  ndn::name::Component ibltHeader = interestName.get(interestName.size()-2);
   ndn::name::Component ibltName = interestName.get(interestName.size()-1);
 
-  IBLT iblt = m_iblt.getIBLTFromName(m_expectedNumEntries, ibltSize, ibltName);
+  for (size_t i = m_syncPrefix.size(); i + 2 < interestName.size(); i++) {
+    const ndn::name::Component& extension = interestName.get(i);
+    if (isSymbolRequest(extension)) {
+      onSymbolRequest(interest, extension);
+      return;
+    }
 
-  _LOG_DEBUG("Equal? " << (m_iblt == iblt));
+    if (IBLT::isDigestComponent(extension) &&
+        IBLT::getDigestFromComponent(extension) == m_ibltDigest) {
+      _LOG_DEBUG("Same digest as ours, nothing to send");
+      addPendingEntry(interest, getIBLTSnapshot());
+      return;
+    }
 
-  IBLT diff = m_iblt - iblt;
+    // If the estimator says the difference is more than the IBF can decode,
+    // answer with our whole state instead of peeling and timing out
+    if (!DifferenceEstimator::isEstimatorComponent(extension)) {
+      continue;
+    }
+    try {
+      size_t estimate = m_estimator.estimateDifference(extension);
+      _LOG_DEBUG("Estimated difference: " << estimate);
+      if (estimate > m_expectedNumEntries) {
+        sendSyncData(interest.getName(), getFullStateReply(std::set<uint32_t>()));
+        return;
+      }
+    }
+    catch (const std::invalid_argument& e) {
+      _LOG_DEBUG("Ignoring estimator: " << e.what());
+    }
+  }
 
   std::set<uint32_t> positive; //non-empty Positive means we have some elements that the others don't
   std::set<uint32_t> negative;
 
-  if (!diff.listEntries(positive, negative)) {
-    _LOG_DEBUG("Send Nack back - disabled");
-    //this->sendApplicationNack(interest);
+  if (IBLT::isDeltaHeader(ibltHeader)) {
+    const IBLT* base = findRecentIBLT(IBLT::getDeltaBase(ibltHeader));
+    if (base == nullptr) {
+      _LOG_DEBUG("Sync interest IBF is a delta against a state we never had");
+      onUnknownDeltaBase(interest);
+      return;
+    }
+    auto iblt = std::make_shared<IBLT>(*base);
+    if (!iblt->applyDelta(ibltName)) {
+      _LOG_DEBUG("Ignoring sync interest with a malformed delta IBF");
+      return;
+    }
+    PeelResult peel = m_iblt.listDifference(*iblt, positive, negative, m_peelWorkspace,
+                                            m_threshold);
+    if (peel == PEEL_FAILED) {
+      _LOG_DEBUG("Cannot peel the difference, fetching rateless symbols");
+      startRatelessRecovery(interest.getName(), iblt->getDigest(),
+                            interest.getInterestLifetime());
+      return;
+    }
+    if (peel == PEEL_AT_BOUND) {
+      _LOG_DEBUG("Difference reaches the threshold, sending our full state");
+      sendSyncData(interest.getName(), getFullStateReply(positive));
+      return;
+    }
+    if (!respondWithDifference(interest.getName(), positive, negative)) {
+      addPendingEntry(interest, iblt);
+    }
+    return;
+  }
+
+  // Subtract and peel straight from the interest's bytes, the received IBF
+  // is only built if the interest has to be kept pending
+  PeelResult peel = m_iblt.listDifference(ibltHeader, ibltName, positive, negative,
+                                          m_peelWorkspace, m_threshold);
+  if (peel == PEEL_AT_BOUND) {
+    _LOG_DEBUG("Difference reaches the threshold, sending our full state");
+    sendSyncData(interest.getName(), getFullStateReply(positive));
     return;
   }
+  if (peel == PEEL_FAILED) {
+    try {
+      uint32_t digest = m_iblt.getIBLTFromName(ibltHeader, ibltName).getDigest();
+      _LOG_DEBUG("Cannot peel the difference, fetching rateless symbols");
+      startRatelessRecovery(interest.getName(), digest, interest.getInterestLifetime());
+    }
+    catch (const std::invalid_argument& e) {
+      _LOG_DEBUG("Ignoring sync interest: " << e.what());
+    }
+    return;
+  }
+
+  if (respondWithDifference(interest.getName(), positive, negative)) {
+    return;
+  }
+
+  // add the entry to the pending entry - if we don't have any new data now
+  addPendingEntry(interest, std::make_shared<const IBLT>(m_iblt.getIBLTFromName(ibltHeader,
+                                                                               ibltName)));
+}
 
+bool
+LogicFull::respondWithDifference(const ndn::Name& interestName,
+                                 const std::set<uint32_t>& positive,
+                                 const std::set<uint32_t>& negative)
+{
   //assert((positive.size() == 1 && negative.size() == 1) || (positive.size() == 0 && negative.size() == 0));
 
   // WE DO NOT CHECK HERE THAT WHAT WE ARE SENDING BACK HAS A GREATER SEQUENCE NUMBER
   // ONLY THAT IT IS DIFFERENT? NOT SURE
-  // WHY DOESN'T hash2prefix store prefixWithSeq
 
   // generate content in Sync reply
-  std::string content;
-  for (const auto& hash : positive) {
-    std::string prefix = m_hash2prefix[hash];
-    // Don't sync up sequence number zero
-    // Only send back own data - disabled - prefix == m_userPrefix.toUri() &&
-    if (m_prefixes[prefix] != 0) {
-      // generate data
-      content += prefix + " " + std::to_string(m_prefixes[prefix]) + "\n";
-      //_LOG_DEBUG("Content: " << prefix << " " << std::to_string(m_prefixes[prefix]));
-    }
-  }
+  // Only send back own data - disabled - prefix == m_userPrefix.toUri() &&
+  std::string content = getContent(positive);
 
   if (positive.size() + negative.size() >= m_threshold || !content.empty()) {
-    sendSyncData(interest.getName(), content);
-    return;
+    sendSyncData(interestName, content);
+    return true;
   }
+  return false;
+}
 
-  // add the entry to the pending entry - if we don't have any new data now
-  std::shared_ptr<PendingEntryInfo> entry = std::make_shared<PendingEntryInfo>(iblt);
-
+void
+LogicFull::addPendingEntry(const ndn::Interest& interest, std::shared_ptr<const IBLT> iblt)
+{
   if (m_pendingEntries.find(interest.getName()) != m_pendingEntries.end()) {
     auto it = m_pendingEntries.find(interest.getName());
     m_scheduler.cancelEvent(it->second->expirationEvent);
@@ -197,6 +354,26 @@ LogicFull::onSyncInterest(const ndn::Name& prefixName, const ndn::Interest& inte
                             });
 }
 
+template<typename Hashes>
+std::string
+LogicFull::getFullStateReply(const Hashes& positive)
+{
+  std::string content = getContent(positive);
+  const std::string& state = getFullStateContent();
+  if (state.empty()) {
+    return content;
+  }
+
+  // Start at a random line, so that replies cut to one packet carry
+  // different parts of the state
+  std::uniform_int_distribution<size_t> dist(0, state.size() - 1);
+  size_t start = state.rfind('\n', dist(m_rng));
+  start = start == std::string::npos ? 0 : start + 1;
+  content.append(state, start, std::string::npos);
+  content.append(state, 0, start);
+  return content;
+}
+
 void
 LogicFull::sendSyncData(const ndn::Name& name, const std::string& content)
 {
@@ -221,12 +398,15 @@ LogicFull::sendSyncData(const ndn::Name& name, const std::string& content)
 
     // Send data after removing pending sync interest on face
     ndn::Name syncDataName = name;
+    IBLT::appendDigestToName(syncDataName, m_ibltDigest);
     m_iblt.appendToName(syncDataName);
 
     ndn::Data data;
     data.setName(syncDataName);
     data.setFreshnessPeriod(m_syncReplyFreshness);
-    data.setContent(reinterpret_cast<const uint8_t*>(content.c_str()), content.length());
+    // A larger state is cut, the peer gets the rest from its next sync interest
+    data.setContent(reinterpret_cast<const uint8_t*>(content.c_str()),
+                    getFittingLength(syncDataName, content));
     m_keyChain.sign(data);
 
     m_face.put(data);
@@ -237,18 +417,189 @@ LogicFull::sendSyncData(const ndn::Name& name, const std::string& content)
   else {
     _LOG_DEBUG("Sending Sync Data");
     ndn::Name syncDataName = name;
+    IBLT::appendDigestToName(syncDataName, m_ibltDigest);
     m_iblt.appendToName(syncDataName);
 
     ndn::Data data;
     data.setName(syncDataName);
     data.setFreshnessPeriod(m_syncReplyFreshness);
-    data.setContent(reinterpret_cast<const uint8_t*>(content.c_str()), content.length());
+    // A larger state is cut, the peer gets the rest from its next sync interest
+    data.setContent(reinterpret_cast<const uint8_t*>(content.c_str()),
+                    getFittingLength(syncDataName, content));
     m_keyChain.sign(data);
 
     m_face.put(data);
   }
 }
 
+void
+LogicFull::onUnknownDeltaBase(const ndn::Interest& interest)
+{
+  // Only answered by the forwarder once every upstream has, so peers that
+  // know the base still reply with the difference
+  ndn::lp::Nack nack(interest);
+  nack.setReason(ndn::lp::NackReason::NO_ROUTE);
+  m_face.put(nack);
+
+  // The sender reads our full IBF and replies with what we miss, which also
+  // tells it we have diverged
+  if (m_numDeltaInterests != 0) {
+    m_numDeltaInterests = FULL_IBLT_INTERVAL;
+    sendSyncInterest();
+  }
+}
+
+void
+LogicFull::startRatelessRecovery(const ndn::Name& interestName, uint32_t digest,
+                                 ndn::time::milliseconds lifetime)
+{
+  if (m_ratelessSessions.find(interestName) != m_ratelessSessions.end()) {
+    return;
+  }
+
+  auto session = std::make_shared<RatelessSession>(m_rateless, digest);
+  session->expirationEvent = m_scheduler.scheduleEvent(lifetime,
+                                                       [this, interestName] {
+                                                         _LOG_DEBUG("Rateless recovery expired");
+                                                         m_ratelessSessions.erase(interestName);
+                                                       });
+  m_ratelessSessions[interestName] = session;
+
+  requestSymbols(interestName);
+}
+
+void
+LogicFull::requestSymbols(const ndn::Name& interestName)
+{
+  auto it = m_ratelessSessions.find(interestName);
+  if (it == m_ratelessSessions.end()) {
+    return;
+  }
+  std::shared_ptr<RatelessSession> session = it->second;
+
+  // Start at twice what the IBF can decode and double from there
+  size_t first = session->decoder.getNumSymbols();
+  size_t n = std::min(std::max(first, static_cast<size_t>(2 * m_expectedNumEntries)),
+                      MAX_SYMBOLS_PER_DATA);
+  if (first + n > MAX_RATELESS_SYMBOLS) {
+    _LOG_DEBUG("Giving up rateless recovery after " << first << " symbols");
+    eraseRatelessSession(interestName);
+    return;
+  }
+
+  std::vector<uint8_t> request(SYMBOL_REQUEST_SIZE);
+  request[0] = MARKER_RATELESS;
+  putUint32(&request[1], session->digest);
+  putUint32(&request[5], first);
+  putUint32(&request[9], n);
+
+  ndn::Name requestName = m_syncPrefix;
+  requestName.append(request.begin(), request.end());
+  m_iblt.appendToName(requestName);
+
+  ndn::Interest symbolInterest(requestName);
+  symbolInterest.setInterestLifetime(m_syncInterestLifetime);
+  symbolInterest.setMustBeFresh(true);
+
+  _LOG_DEBUG("Requesting rateless symbols " << first << " to " << first + n);
+
+  m_face.expressInterest(symbolInterest,
+                         std::bind(&LogicFull::onSymbolData, this, interestName, _1, _2),
+                         [this, interestName] (const ndn::Interest&, const ndn::lp::Nack&) {
+                           eraseRatelessSession(interestName);
+                         },
+                         [this, interestName] (const ndn::Interest&) {
+                           eraseRatelessSession(interestName);
+                         });
+}
+
+void
+LogicFull::onSymbolRequest(const ndn::Interest& interest, const ndn::name::Component& request)
+{
+  uint32_t digest = getUint32(request.value() + 1);
+  size_t first = getUint32(request.value() + 5);
+  size_t n = getUint32(request.value() + 9);
+
+  if (n == 0 || n > MAX_SYMBOLS_PER_DATA || first + n > MAX_RATELESS_SYMBOLS) {
+    _LOG_DEBUG("Ignoring symbol request for " << n << " symbols from " << first);
+    return;
+  }
+
+  if (m_ibltDigest != digest) {
+    _LOG_DEBUG("Symbol request is for another state");
+    return;
+  }
+
+  std::vector<uint8_t> symbols = m_rateless.encodeSymbols(first, n);
+
+  ndn::Name symbolDataName = interest.getName();
+  symbolDataName.append(request.value(), 1);
+
+  ndn::Data data;
+  data.setName(symbolDataName);
+  data.setFreshnessPeriod(m_syncReplyFreshness);
+  data.setContent(symbols.data(), symbols.size());
+  m_keyChain.sign(data);
+
+  m_face.put(data);
+}
+
+void
+LogicFull::onSymbolData(const ndn::Name& interestName, const ndn::Interest& interest,
+                        const ndn::Data& data)
+{
+  if (data.getName().size() <= interest.getName().size() ||
+      !isSymbolReply(data.getName().get(-1))) {
+    _LOG_DEBUG("Symbol request answered as a sync interest");
+    onSyncData(interest, data);
+    return;
+  }
+
+  auto it = m_ratelessSessions.find(interestName);
+  if (it == m_ratelessSessions.end()) {
+    return;
+  }
+  std::shared_ptr<RatelessSession> session = it->second;
+
+  if (session->localVersion != m_rateless.getVersion()) {
+    _LOG_DEBUG("Our state changed during rateless recovery, dropping it");
+    eraseRatelessSession(interestName);
+    return;
+  }
+
+  const ndn::name::Component& request = interest.getName().get(m_syncPrefix.size());
+  size_t n = data.getContent().value_size() / RatelessIBLT::SYMBOL_SIZE;
+  if (getUint32(request.value() + 5) != session->decoder.getNumSymbols() ||
+      n != getUint32(request.value() + 9)) {
+    _LOG_DEBUG("Unexpected symbol reply");
+    eraseRatelessSession(interestName);
+    return;
+  }
+
+  if (!session->decoder.addSymbols(data.getContent().value(), n)) {
+    requestSymbols(interestName);
+    return;
+  }
+
+  _LOG_DEBUG("Decoded difference from " << session->decoder.getNumSymbols() << " symbols, "
+             << session->decoder.getPositive().size() << " to send");
+
+  std::string content = getContent(session->decoder.getPositive());
+
+  eraseRatelessSession(interestName);
+  sendSyncData(interestName, content);
+}
+
+void
+LogicFull::eraseRatelessSession(const ndn::Name& interestName)
+{
+  auto it = m_ratelessSessions.find(interestName);
+  if (it != m_ratelessSessions.end()) {
+    m_scheduler.cancelEvent(it->second->expirationEvent);
+    m_ratelessSessions.erase(it);
+  }
+}
+
 void
 LogicFull::onSyncData(const ndn::Interest& interest, const ndn::Data& data)
 {
@@ -338,6 +689,15 @@ LogicFull::onSyncNack(const ndn::Interest& interest, const ndn::lp::Nack& nack)
 {
   _LOG_TRACE("received Nack with reason " << nack.getReason()
              << " for Interest with Nonce: " << interest.getNonce());
+
+  // No peer could rebuild our delta IBF, send the full one right away
+  const ndn::Name& name = interest.getName();
+  if (name.size() >= 2 && IBLT::isDeltaHeader(name.get(-2)) &&
+      name == m_outstandingInterestName) {
+    _LOG_DEBUG("Delta IBF Nacked, sending the full one");
+    m_numDeltaInterests = FULL_IBLT_INTERVAL;
+    sendSyncInterest();
+  }
 }
 
 void
@@ -345,6 +705,9 @@ LogicFull::satisfyPendingInterests()
 {
   _LOG_DEBUG("Satisfying full sync interest: " << m_pendingEntries.size());
   std::vector <ndn::Name> prefixToErase(m_pendingEntries.size());
+  // reused across the entries, so they only allocate while growing
+  std::vector<uint32_t> positive;
+  std::vector<uint32_t> negative;
 
   // Satisfy pending interests from other producers
   // If you put this to const auto& prefixToErase.push_back will get a
@@ -352,15 +715,22 @@ LogicFull::satisfyPendingInterests()
   for (auto pendingInterest : m_pendingEntries) {
     // go through each pendingEntries
     std::shared_ptr<PendingEntryInfo> entry = pendingInterest.second;
-    IBLT diff = m_iblt - entry->iblt;
-    std::set<uint32_t> positive;
-    std::set<uint32_t> negative;
-
-    _LOG_DEBUG("Equal? " << (m_iblt == entry->iblt));
-
-    if (!diff.listEntries(positive, negative)) {
-      _LOG_DEBUG("Send Nack disabled, continue");
-      //this->sendApplicationNack(pendingInterest.first);
+    positive.clear();
+    negative.clear();
+
+    PeelResult peel = m_iblt.listDifference(*entry->iblt, positive, negative, m_peelWorkspace,
+                                            m_threshold);
+    if (peel == PEEL_FAILED) {
+      _LOG_DEBUG("Cannot peel the difference, fetching rateless symbols");
+      startRatelessRecovery(pendingInterest.first, entry->iblt->getDigest(),
+                            m_syncInterestLifetime);
+      prefixToErase.push_back(pendingInterest.first);
+      m_scheduler.cancelEvent(entry->expirationEvent);
+      continue;
+    }
+    if (peel == PEEL_AT_BOUND) {
+      _LOG_DEBUG("Difference reaches the threshold, sending our full state");
+      sendSyncData(pendingInterest.first, getFullStateReply(positive));
       prefixToErase.push_back(pendingInterest.first);
       m_scheduler.cancelEvent(entry->expirationEvent);
       continue;
@@ -376,17 +746,8 @@ LogicFull::satisfyPendingInterests()
 
     // We need to do go over hash and not just use prefix because
     // we don't send sync data upon receiving sync data from other side
-    std::string content;
-    for (const auto& hash : positive) {
-      std::string prefix = m_hash2prefix[hash];
-      // Don't sync up sequence number zero
-      // Only send back own data - disabled - prefix == m_userPrefix.toUri() &&
-      if (m_prefixes[prefix] != 0) {
-        // generate data
-        content += prefix + " " + std::to_string(m_prefixes[prefix]) + "\n";
-        //_LOG_DEBUG("Content: " << prefix << " " << std::to_string(m_prefixes[prefix]));
-      }
-    }
+    // Only send back own data - disabled - prefix == m_userPrefix.toUri() &&
+    std::string content = getContent(positive);
 
     if (positive.size() + negative.size() >= m_threshold || !content.empty()) {
       sendSyncData(pendingInterest.first, content);
@@ -426,4 +787,37 @@ LogicFull::deletePendingInterests(const ndn::Name& interestName) {
   }
 }
 
+void
+LogicFull::rememberIBLT()
+{
+  if (!m_recentIBLTs.empty() && m_recentIBLTs.back().first == m_ibltDigest) {
+    return;
+  }
+
+  m_recentIBLTs.emplace_back(m_ibltDigest, m_iblt);
+  if (m_recentIBLTs.size() > MAX_RECENT_IBLTS) {
+    m_recentIBLTs.pop_front();
+  }
+}
+
+std::shared_ptr<const IBLT>
+LogicFull::getIBLTSnapshot()
+{
+  if (m_ibltSnapshot == nullptr || m_ibltSnapshot->getVersion() != m_iblt.getVersion()) {
+    m_ibltSnapshot = std::make_shared<const IBLT>(m_iblt);
+  }
+  return m_ibltSnapshot;
+}
+
+const IBLT*
+LogicFull::findRecentIBLT(uint32_t digest) const
+{
+  for (auto it = m_recentIBLTs.rbegin(); it != m_recentIBLTs.rend(); ++it) {
+    if (it->first == digest) {
+      return &it->second;
+    }
+  }
+  return nullptr;
+}
+
 } // namespace psync
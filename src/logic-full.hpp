@@ -25,6 +25,7 @@
 #include "util.hpp"
 #include "logic-base.hpp"
 
+#include <deque>
 #include <map>
 #include <unordered_set>
 #include <random>
@@ -38,11 +39,30 @@
 namespace psync {
 
 struct PendingEntryInfo {
-  PendingEntryInfo(const IBLT& iblt)
+  PendingEntryInfo(std::shared_ptr<const IBLT> iblt)
   : iblt(iblt)
   {}
 
-  IBLT iblt;
+  // shared with the other entries of peers in the same state
+  std::shared_ptr<const IBLT> iblt;
+  ndn::EventId expirationEvent;
+};
+
+/**
+ * @brief State of fetching a peer's rateless symbols after its IBF could not be peeled
+ */
+struct RatelessSession {
+  RatelessSession(RatelessIBLT& local, uint32_t digest)
+  : decoder(local)
+  , digest(digest)
+  , localVersion(local.getVersion())
+  {}
+
+  RatelessDecoder decoder;
+  // identifies the peer's state, see IBLT::getDigest
+  uint32_t digest;
+  // our own state must not change while decoding
+  uint64_t localVersion;
   ndn::EventId expirationEvent;
 };
 
@@ -85,7 +105,9 @@ private:
   /**
    * @brief Send sync interest for full synchronization
    *
-   * Forms the interest name: /<sync-prefix>/full-sync/<own-IBF>
+   * Forms the interest name: /<sync-prefix>/<own-digest>/<own-estimator>/<own-IBF>
+   * The IBF only carries the cells that changed since the one we sent last,
+   * except every FULL_IBLT_INTERVAL interests
    * Cancels any pending sync interest we sent earlier on the face
    * Sends the sync interest
    */
@@ -95,9 +117,20 @@ private:
   /**
    * @brief Process sync interest from other parties
    *
-   * Extract IBF from the @p interest
+   * If the @p interest carries the digest of our own IBF, the sender is in sync with
+   * us: keep it pending without decoding its IBF and return
+   *
+   * If the @p interest carries a difference estimator and the estimated difference
+   * is larger than the IBF can decode, reply with our full state and return
+   *
+   * If the @p interest is a request for our rateless symbols, answer it and return
+   *
+   * Extract IBF from the @p interest, rebuilding it from m_recentIBLTs if it is a delta
+   * (if we never had its base, onUnknownDeltaBase and return)
    * Get differences b/w our IBF and this IBF
-   *   If we cannot get the differences successfully then send application level Nack (Disabled currently)
+   *   If we cannot get the differences successfully then fetch the other side's
+   *   rateless symbols until we can (startRatelessRecovery)
+   *   If peeling stops at m_threshold differences, reply with our full state and return
    *
    * If have some things in our IBF that the other side does not have, reply with the content
    * or if # of new data items is greater than threshold then reply with whatever content we have that other side don't
@@ -112,9 +145,101 @@ private:
   void
   onSyncInterest(const ndn::Name& prefixName, const ndn::Interest& interest);
 
+  /**
+   * @brief Send what the sender of a sync interest is missing, if anything
+   *
+   * @return true if the interest was answered
+   */
+  bool
+  respondWithDifference(const ndn::Name& interestName, const std::set<uint32_t>& positive,
+                        const std::set<uint32_t>& negative);
+
+  /**
+   * @brief Keep the sync interest with the IBF @p iblt until we have new data for it
+   */
+  void
+  addPendingEntry(const ndn::Interest& interest, std::shared_ptr<const IBLT> iblt);
+
+  /**
+   * @brief Copy of m_iblt shared by the pending entries of peers in sync with us,
+   *        taken again only after m_iblt changed
+   */
+  std::shared_ptr<const IBLT>
+  getIBLTSnapshot();
+
+  /**
+   * @brief Content answering a peer whose difference we could not list
+   *
+   * The prefixes in @p positive, which the peer is known to miss, come first,
+   * followed by our whole state starting at a random line. sendSyncData cuts
+   * the content to one packet, so a large state reaches the peer over several
+   * sync rounds.
+   */
+  template<typename Hashes>
+  std::string
+  getFullStateReply(const Hashes& positive);
+
+  /**
+   * @brief Reply to the sync interest @p name with @p content, cut at a line
+   *        end to fit one packet
+   */
   void
   sendSyncData(const ndn::Name& name, const std::string& content);
 
+  /**
+   * @brief Handle a sync interest whose delta IBF we cannot rebuild
+   *
+   * Nacks the interest instead of answering it with data, so that the peers
+   * that know its base still reply: the sender only gets the Nack if none of
+   * them does, and then sends its full IBF (see onSyncNack). Unless it already
+   * is, our own next sync interest carries the full IBF, sent right away, so
+   * that the sender learns what we are missing.
+   */
+  void
+  onUnknownDeltaBase(const ndn::Interest& interest);
+
+  /**
+   * @brief Recover the difference with the sender of a sync interest whose IBF
+   *        could not be peeled
+   *
+   * Fetches the rateless symbols of the sender's state block by block from
+   * whoever holds that state, keeping the sync interest @p interestName pending
+   * until they decode, then answers it with what the sender is missing.
+   *
+   * Symbol request: /<sync-prefix>/<request>/<own-IBF>
+   * where request holds the digest of the sender's IBF and the range of symbols.
+   * Our IBF is appended so that older peers read it as a sync interest.
+   *
+   * @param interestName name of the sync interest to answer
+   * @param digest IBLT::getDigest of the sender's IBF
+   * @param lifetime how long that interest stays pending
+   */
+  void
+  startRatelessRecovery(const ndn::Name& interestName, uint32_t digest,
+                        ndn::time::milliseconds lifetime);
+
+  void
+  requestSymbols(const ndn::Name& interestName);
+
+  /**
+   * @brief Answer a symbol request if its digest matches our current state
+   *
+   * Reply name: /<request-name>/<reply-marker>, content: the symbols
+   */
+  void
+  onSymbolRequest(const ndn::Interest& interest, const ndn::name::Component& request);
+
+  /**
+   * @brief Add received symbols to the decoder, ask for more or answer the
+   *        pending sync interest @p interestName once decoded
+   */
+  void
+  onSymbolData(const ndn::Name& interestName, const ndn::Interest& interest,
+               const ndn::Data& data);
+
+  void
+  eraseRatelessSession(const ndn::Name& interestName);
+
   /**
    * @brief Process sync data
    *
@@ -149,6 +274,9 @@ private:
    *
    * sendSyncInterest after 500 ms + 10-50 ms jitter
    *
+   * If the interest carried a delta IBF no peer could rebuild, sendSyncInterest
+   * right away with the full IBF
+   *
    * @param interest interest for which we got the timeout for
    * @param nack nack packet
    */
@@ -171,11 +299,22 @@ private:
   void
   deletePendingInterests(const ndn::Name& interestName);
 
+  /**
+   * @brief Add our current IBF to m_recentIBLTs, the bases we can rebuild deltas from
+   */
+  void
+  rememberIBLT();
+
+  const IBLT*
+  findRecentIBLT(uint32_t digest) const;
+
 private:
   // std::bad_alloc if we do not use shared_pointer for PendingEntryInfo
   // on map insert
   // Need a new dedicated class like ChronoSync's interest table to manage these?
   std::map <ndn::Name, std::shared_ptr<PendingEntryInfo>> m_pendingEntries;
+  // keyed by the sync interest each session will answer
+  std::map <ndn::Name, std::shared_ptr<RatelessSession>> m_ratelessSessions;
 
   ndn::time::milliseconds m_syncInterestLifetime;
   ndn::time::milliseconds m_syncReplyFreshness;
@@ -187,6 +326,15 @@ private:
   std::uniform_int_distribution<> m_jitter;
 
   ndn::Name m_outstandingInterestName;
+
+  // Our last few states, oldest first, keyed by IBLT::getDigest. Peers that were
+  // in one of them send deltas against it
+  std::deque<std::pair<uint32_t, IBLT>> m_recentIBLTs;
+  // digest of the IBF in our last sync interest
+  uint32_t m_lastSentDigest;
+  size_t m_numDeltaInterests;
+
+  std::shared_ptr<const IBLT> m_ibltSnapshot;
 };
 
 } // namespace psync
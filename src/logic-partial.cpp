@@ -19,6 +19,7 @@
 
 #include "logic-partial.hpp"
 #include "logging.hpp"
+#include "sync-interest.hpp"
 #include "util.hpp"
 
 #include <iostream>
@@ -29,8 +30,6 @@ namespace psync {
 
 _LOG_INIT(LogicPartial);
 
-static const size_t N_HASHCHECK = 11;
-
 LogicPartial::LogicPartial(size_t expectedNumEntries,
                            ndn::Face& face,
                            const ndn::Name& syncPrefix,
@@ -96,6 +95,7 @@ LogicPartial::onHelloInterest(const ndn::Name& prefix, const ndn::Interest& inte
   _LOG_DEBUG("sending content p: " << content);
 
   ndn::Name segmentPrefix = prefix;
+  IBLT::appendDigestToName(segmentPrefix, m_ibltDigest);
   m_iblt.appendToName(segmentPrefix);
 
   sendFragmentedData(segmentPrefix, content);
@@ -145,37 +145,20 @@ LogicPartial::onSyncInterest(const ndn::Name& prefix, const ndn::Interest& inter
   _LOG_DEBUG("Sync Interest Received, Nonce: " << interest.getNonce()
               << " " << std::hash<std::string>{}(interest.getName().toUri()));
 
-  // parser BF and IBLT Not finished yet
-  ndn::Name interestName = interest.getName();
-  _LOG_DEBUG(interestName.get(interestName.size()-4));
-  std::size_t bfSize = interestName.get(interestName.size()-4).toNumber();
-  ndn::name::Component bfName = interestName.get(interestName.size()-3);
-  std::size_t ibltSize = interestName.get(interestName.size()-2).toNumber();
-  ndn::name::Component ibltName = interestName.get(interestName.size()-1);
-
-  bloom_parameters opt;
-  opt.projected_element_count = interestName.get(interestName.size()-6).toNumber();
-  //_LOG_DEBUG("Elemen count of BF: " << opt.projected_element_count);
-  //_LOG_DEBUG("Probab of BF: " << interestName.get(interestName.size()-5).toNumber()/1000.);
-  opt.false_positive_probability = interestName.get(interestName.size()-5).toNumber()/1000.;
-  opt.compute_optimal_parameters();
-  bloom_filter bf(opt);
-  bf.setTable(std::vector <uint8_t>(bfName.begin() + getSize(bfSize), bfName.end()));
-
-  std::vector <uint8_t> testTable(bfName.begin(), bfName.end());
-
-  std::vector <uint8_t> ibltValues(ibltName.begin() + getSize(ibltSize), ibltName.end());
-  std::size_t N = ibltValues.size()/4;
-  std::vector <uint32_t> values(N, 0);
-
-  for (uint i = 0; i < 4*N; i += 4) {
-    uint32_t t = (ibltValues[i+3] << 24) + (ibltValues[i+2] << 16) + (ibltValues[i+1] << 8) + ibltValues[i];
-    values[i/4] = t;
+  // The IBF and Bloom filter components are read in place
+  PartialSyncInterest syncInterest;
+  if (!parsePartialSyncInterest(interest.getName(), syncInterest)) {
+    _LOG_DEBUG("Malformed sync interest, ignoring it");
+    return;
+  }
+  const ndn::name::Component& ibltHeader = *syncInterest.ibltHeader;
+  const ndn::name::Component& ibltName = *syncInterest.ibltTable;
+  if (!m_iblt.canReadFromName(ibltHeader, ibltName)) {
+    _LOG_DEBUG("Cannot read the IBF of the sync interest, ignoring it");
+    return;
   }
+  Subscription subscription = syncInterest.getSubscription();
 
-  // get the difference
-  IBLT iblt(m_expectedNumEntries, values);
-  IBLT diff = m_iblt - iblt;
   std::set<uint32_t> positive; //non-empty Positive means we have some elements that the others don't
   std::set<uint32_t> negative;
 
@@ -187,30 +170,35 @@ LogicPartial::onSyncInterest(const ndn::Name& prefix, const ndn::Interest& inter
   //_LOG_DEBUG("Difference size: " << diff.getHashTable().size());
   _LOG_DEBUG("Num elements in IBF: " << m_prefixes.size());
 
-  bool peel = diff.listEntries(positive, negative);
+  // A consumer that sends our own digest is up to date, there is nothing to peel
+  bool isInSync = syncInterest.hasDigest && syncInterest.digest == m_ibltDigest;
+
+  PeelResult peel = isInSync ? PEEL_COMPLETE :
+                     m_iblt.listDifference(ibltHeader, ibltName, positive, negative,
+                                           m_peelWorkspace, m_threshold);
 
   _LOG_DEBUG("diff.listEntries: " << peel);
 
-  /*if (!peel) {
-    _LOG_DEBUG("Send Nack back");
-    this->sendNack(interest);
+  // The consumer only holds our old IBF, so there is nothing to fetch from it:
+  // send it all the subscribed prefixes, it skips the ones it already has.
+  // The same goes for a difference that reaches the threshold, of which only
+  // part was peeled
+  if (peel != PEEL_COMPLETE) {
+    _LOG_DEBUG("Cannot peel the whole difference, sending all subscribed prefixes");
+    ndn::Name syncDataName = interest.getName();
+    IBLT::appendDigestToName(syncDataName, m_ibltDigest);
+    m_iblt.appendToName(syncDataName);
+    sendFragmentedData(syncDataName, getFullStateContent(subscription));
     return;
-  }*/
+  }
 
   //assert((positive.size() == 1 && negative.size() == 1) || (positive.size() == 0 && negative.size() == 0));
 
   // generate content in Sync reply
-  std::string content;
   _LOG_DEBUG("Size of positive set " << positive.size());
   _LOG_DEBUG("Size of negative set " << negative.size());
-  for (const auto& hash : positive) {
-    std::string prefix = m_hash2prefix[hash];
-    if (bf.contains(prefix)) {
-      // generate data
-      content += prefix + " " + std::to_string(m_prefixes[prefix]) + "\n";
-      _LOG_DEBUG("Content: " << prefix << " " << std::to_string(m_prefixes[prefix]));
-    }
-  }
+  std::string content = getContent(positive, subscription);
+  _LOG_DEBUG("Content: " << content);
 
   _LOG_DEBUG("m_threshold: " << m_threshold << " Total: " << positive.size() + negative.size());
 
@@ -222,6 +210,7 @@ LogicPartial::onSyncInterest(const ndn::Name& prefix, const ndn::Interest& inter
     // send back data
     //std::shared_ptr<ndn::Data> data = std::make_shared<ndn::Data>();
     ndn::Name syncDataName = interest.getName();
+    IBLT::appendDigestToName(syncDataName, m_ibltDigest);
     m_iblt.appendToName(syncDataName);
 
     /*data->setName(syncDataName);
@@ -238,8 +227,10 @@ LogicPartial::onSyncInterest(const ndn::Name& prefix, const ndn::Interest& inter
   }
 
   // add the entry to the pending entry - if we don't have any new data now
-  std::shared_ptr<PendingEntryInfo> entry = std::make_shared<PendingEntryInfo>(bf, iblt);
-  //PendingEntryInfo entry(bf, iblt);
+  IBLT iblt = isInSync ? m_iblt
+                       : m_iblt.getIBLTFromName(ibltHeader, ibltName);
+  std::shared_ptr<PendingEntryInfo> entry = std::make_shared<PendingEntryInfo>(std::move(subscription),
+                                                                              std::move(iblt));
 
   // Because insert member function will have no effect if the key is already present in the map
   if (m_pendingEntries.find(interest.getName()) != m_pendingEntries.end()) {
@@ -270,6 +261,9 @@ void
 LogicPartial::satisfyPendingSyncInterests(const std::string& prefix) {
   _LOG_DEBUG("size of pending interest: " << m_pendingEntries.size());
   std::vector <ndn::Name> prefixToErase;
+  // reused across the entries, so they only allocate while growing
+  std::vector<uint32_t> positive;
+  std::vector<uint32_t> negative;
 
   // Satisfy pending interests
   for (const auto& pendingInterest : m_pendingEntries) {
@@ -280,11 +274,11 @@ LogicPartial::satisfyPendingSyncInterests(const std::string& prefix) {
     //PendingEntryInfo entry = pendingInterest.second;
     std::shared_ptr<PendingEntryInfo> entry = pendingInterest.second;
     if (!entry) {continue;}
-    IBLT diff = m_iblt - entry->iblt;
-    std::set<uint32_t> positive;
-    std::set<uint32_t> negative;
+    positive.clear();
+    negative.clear();
 
-    bool peel = diff.listEntries(positive, negative);
+    PeelResult peel = m_iblt.listDifference(entry->iblt, positive, negative, m_peelWorkspace,
+                                            m_threshold);
 
     //printEntries(m_iblt, "MyIBF");
     //printEntries(entry->iblt, "pending IBF");
@@ -295,18 +289,22 @@ LogicPartial::satisfyPendingSyncInterests(const std::string& prefix) {
     _LOG_TRACE("Num elements in IBF: " << m_prefixes.size());
     _LOG_TRACE("m_threshold: " << m_threshold << " Total: " << positive.size() + negative.size());
 
-    if (!peel) {
+    if (peel != PEEL_COMPLETE) {
       _LOG_DEBUG("Cannot peel all the difference between pending IBF and our current IBF");
-      _LOG_DEBUG("Deleted pending sync interest");
-      //this->sendNack(pendingInterest.first);
+      _LOG_DEBUG("Sending all subscribed prefixes");
+      ndn::Name syncDataName = pendingInterest.first;
+      IBLT::appendDigestToName(syncDataName, m_ibltDigest);
+      m_iblt.appendToName(syncDataName);
+      sendFragmentedData(syncDataName, getFullStateContent(entry->subscription));
       prefixToErase.push_back(pendingInterest.first);
       m_scheduler.cancelEvent(entry->expirationEvent);
       continue;
     }
 
-    if (entry->bf.contains(prefix) || positive.size() + negative.size() >= m_threshold) {
+    bool isSubscribed = entry->subscription.contains(prefix);
+    if (isSubscribed || positive.size() + negative.size() >= m_threshold) {
       std::string syncContent;
-      if (entry->bf.contains(prefix)) {
+      if (isSubscribed) {
          _LOG_DEBUG("sending sync content " << prefix << " " << std::to_string(m_prefixes[prefix]));
          syncContent = prefix + " " + std::to_string(m_prefixes[prefix]);
       }
@@ -316,6 +314,7 @@ LogicPartial::satisfyPendingSyncInterests(const std::string& prefix) {
 
       // generate sync data and cancel the scheduler
       ndn::Name syncDataName = pendingInterest.first;
+      IBLT::appendDigestToName(syncDataName, m_ibltDigest);
       m_iblt.appendToName(syncDataName);
 
       sendFragmentedData(syncDataName, syncContent);
@@ -23,6 +23,7 @@
 #include "iblt.hpp"
 #include "bloom-filter.hpp"
 #include "logic-base.hpp"
+#include "sync-interest.hpp"
 
 #include <map>
 #include <unordered_set>
@@ -35,13 +36,13 @@
 namespace psync {
 
 struct PendingEntryInfo {
-  PendingEntryInfo(const bloom_filter& bf, const IBLT& iblt)
-  : bf(bf)
-  , iblt(iblt)
+  PendingEntryInfo(Subscription subscription, IBLT iblt)
+  : subscription(std::move(subscription))
+  , iblt(std::move(iblt))
   , expirationEvent(0)
   {}
 
-  bloom_filter bf;
+  Subscription subscription;
   IBLT iblt;
   ndn::EventId expirationEvent;
 };
@@ -5,6 +5,7 @@
 #include <limits>
 
 #include "logic-repo.hpp"
+#include "sync-interest.hpp"
 
 #include <ndn-cxx/common.hpp>
 
@@ -20,8 +21,6 @@ namespace psync {
 
   _LOG_INIT(LogicRepo);
 
-  static const size_t N_HASHCHECK = 11;
-
   LogicRepo::LogicRepo(size_t expectedNumEntries,
 		       ndn::Face& face,
 		       ndn::Name& prefix,
@@ -30,6 +29,7 @@ namespace psync {
     : m_iblt(expectedNumEntries)
     , m_expectedNumEntries(expectedNumEntries)
     , m_threshold(expectedNumEntries/2)
+    , m_isFullStateContentCurrent(false)
     , m_face(face)
     , m_syncPrefix(prefix)
     , m_scheduler(m_face.getIoService())
@@ -67,7 +67,7 @@ namespace psync {
 
     // add it to the iblt.
     std::string prefixWithSeq = prefix + "/" + std::to_string(m_prefixes[prefix]);
-    uint32_t newHash = MurmurHash3(N_HASHCHECK, ParseHex(prefixWithSeq));
+    uint32_t newHash = MurmurHash3(IBLT::N_HASHCHECK, ParseHex(prefixWithSeq));
     m_prefix2hash[prefixWithSeq] = newHash;
     m_hash2prefix[newHash] = prefix;
     m_iblt.insert(newHash);
@@ -84,6 +84,7 @@ namespace psync {
     if (m_prefixes.find(prefix) != m_prefixes.end()) {
       uint32_t seqNo = m_prefixes[prefix];
       m_prefixes.erase(prefix);
+      m_isFullStateContentCurrent = false;
       std::string prefixWithSeq = prefix + "/" + std::to_string(seqNo);
       uint32_t hash = m_prefix2hash[prefixWithSeq];
       m_prefix2hash.erase(prefixWithSeq);
@@ -208,37 +209,20 @@ namespace psync {
     _LOG_DEBUG("Sync Interest Received, Nonce: " << interest.getNonce()
 	       << " " << std::hash<std::string>{}(interest.getName().toUri()));
 
-    // parser BF and IBLT Not finished yet
-    ndn::Name interestName = interest.getName();
-    _LOG_DEBUG(interestName.get(interestName.size()-4));
-    std::size_t bfSize = interestName.get(interestName.size()-4).toNumber();
-    ndn::name::Component bfName = interestName.get(interestName.size()-3);
-    std::size_t ibltSize = interestName.get(interestName.size()-2).toNumber();
-    ndn::name::Component ibltName = interestName.get(interestName.size()-1);
-
-    bloom_parameters opt;
-    opt.projected_element_count = interestName.get(interestName.size()-6).toNumber();
-    //_LOG_DEBUG("Elemen count of BF: " << opt.projected_element_count);
-    //_LOG_DEBUG("Probab of BF: " << interestName.get(interestName.size()-5).toNumber()/1000.);
-    opt.false_positive_probability = interestName.get(interestName.size()-5).toNumber()/1000.;
-    opt.compute_optimal_parameters();
-    bloom_filter bf(opt);
-    bf.setTable(std::vector <uint8_t>(bfName.begin()+this->getSize(bfSize), bfName.end()));
-
-    std::vector <uint8_t> testTable(bfName.begin(), bfName.end());
-
-    std::vector <uint8_t> ibltValues(ibltName.begin()+this->getSize(ibltSize), ibltName.end());
-    std::size_t N = ibltValues.size()/4;
-    std::vector <uint32_t> values(N, 0);
-
-    for (uint i = 0; i < 4*N; i += 4) {
-      uint32_t t = (ibltValues[i+3] << 24) + (ibltValues[i+2] << 16) + (ibltValues[i+1] << 8) + ibltValues[i];
-      values[i/4] = t;
+    // The IBF and Bloom filter components are read in place
+    PartialSyncInterest syncInterest;
+    if (!parsePartialSyncInterest(interest.getName(), syncInterest)) {
+      _LOG_DEBUG("Malformed sync interest, ignoring it");
+      return;
     }
+    const ndn::name::Component& ibltHeader = *syncInterest.ibltHeader;
+    const ndn::name::Component& ibltName = *syncInterest.ibltTable;
+    if (!m_iblt.canReadFromName(ibltHeader, ibltName)) {
+      _LOG_DEBUG("Cannot read the IBF of the sync interest, ignoring it");
+      return;
+    }
+    Subscription subscription = syncInterest.getSubscription();
 
-    // get the difference
-    IBLT iblt(m_expectedNumEntries, values);
-    IBLT diff = m_iblt - iblt;
     std::set<uint32_t> positive; //non-empty Positive means we have some elements that the others don't
     std::set<uint32_t> negative;
 
@@ -250,15 +234,22 @@ namespace psync {
     //_LOG_DEBUG("Difference size: " << diff.getHashTable().size());
     _LOG_DEBUG("Num elements in IBF: " << m_prefixes.size());
 
-    bool peel = diff.listEntries(positive, negative);
+    PeelResult peel = m_iblt.listDifference(ibltHeader, ibltName, positive, negative,
+                                            m_peelWorkspace, m_threshold);
 
     _LOG_DEBUG("diff.listEntries: " << peel);
 
-    /*if (!peel) {
-    _LOG_DEBUG("Send Nack back");
-    this->sendNack(interest);
-    return;
-    }*/
+    // The consumer only holds our old IBF, so there is nothing to fetch from it:
+    // send it all the subscribed prefixes, it skips the ones it already has.
+    // The same goes for a difference that reaches the threshold, of which only
+    // part was peeled
+    if (peel != PEEL_COMPLETE) {
+      _LOG_DEBUG("Cannot peel the whole difference, sending all subscribed prefixes");
+      ndn::Name syncDataName = interest.getName();
+      appendIBLT(syncDataName);
+      sendFragmentedData(syncDataName, getFullStateContent(subscription));
+      return;
+    }
 
     //assert((positive.size() == 1 && negative.size() == 1) || (positive.size() == 0 && negative.size() == 0));
 
@@ -268,7 +259,7 @@ namespace psync {
     _LOG_DEBUG("Size of negative set " << negative.size());
     for (auto hash : positive) {
       std::string prefix = m_hash2prefix[hash];
-      if (bf.contains(prefix)) {
+      if (subscription.contains(prefix)) {
 	// generate data
 	content += prefix + " " + std::to_string(m_prefixes[prefix]) + "\n";
 	_LOG_DEBUG("Content: " << prefix << " " << std::to_string(m_prefixes[prefix]));
@@ -301,7 +292,9 @@ namespace psync {
     }
 
     // add the entry to the pending entry - if we don't have any new data now
-    std::shared_ptr<PendingEntryInfo> entry = std::make_shared<PendingEntryInfo>(bf, iblt);
+    IBLT iblt = m_iblt.getIBLTFromName(ibltHeader, ibltName);
+    std::shared_ptr<PendingEntryInfo> entry = std::make_shared<PendingEntryInfo>(std::move(subscription),
+                                                                                std::move(iblt));
     //PendingEntryInfo entry(bf, iblt);
 
     // Because insert member function will have no effect if the key is already present in the map
@@ -339,40 +332,9 @@ namespace psync {
   LogicRepo::appendIBLT(ndn::Name& name)
   {
     printEntries(m_iblt, "appending m_iblt");
-    std::vector <HashTableEntry> hashTable = m_iblt.getHashTable();
-    size_t N = hashTable.size();
-    size_t unitSize = 32*3/8; // hard coding
-    size_t tableSize = unitSize*N;
-
-    std::vector <uint8_t> table(tableSize);
-
-    for (uint i = 0; i < N; i++) {
-      // table[i*12],   table[i*12+1], table[i*12+2], table[i*12+3] --> hashTable[i].count
-
-      table[i*12]   = 0xFF & hashTable[i].count;
-      table[i*12+1] = 0xFF & (hashTable[i].count >> 8);
-      table[i*12+2] = 0xFF & (hashTable[i].count >> 16);
-      table[i*12+3] = 0xFF & (hashTable[i].count >> 24);
-
-      // table[i*12+4], table[i*12+5], table[i*12+6], table[i*12+7] --> hashTable[i].keySum
-
-      table[i*12+4] = 0xFF & hashTable[i].keySum;
-      table[i*12+5] = 0xFF & (hashTable[i].keySum >> 8);
-      table[i*12+6] = 0xFF & (hashTable[i].keySum >> 16);
-      table[i*12+7] = 0xFF & (hashTable[i].keySum >> 24);
-
-      // table[i*12+8], table[i*12+9], table[i*12+10], table[i*12+11] --> hashTable[i].keyCheck
-
-      table[i*12+8] = 0xFF & hashTable[i].keyCheck;
-      table[i*12+9] = 0xFF & (hashTable[i].keyCheck >> 8);
-      table[i*12+10] = 0xFF & (hashTable[i].keyCheck >> 16);
-      table[i*12+11] = 0xFF & (hashTable[i].keyCheck >> 24);
-    }
-
-    name.appendNumber(table.size());
-    _LOG_DEBUG("Size of IBF hash table: " << hashTable.size());
-    _LOG_DEBUG("Size of table appended: " << table.size());
-    name.append(table.begin(), table.end());
+    m_iblt.appendToName(name);
+    _LOG_DEBUG("Size of IBF hash table: " << m_iblt.getNumEntry());
+    _LOG_DEBUG("Size of table appended: " << name.get(-1).value_size());
   }
 
   void
@@ -425,8 +387,9 @@ namespace psync {
 
     // Insert the new seq no
     m_prefixes[prefix] = seq;
+    m_isFullStateContentCurrent = false;
     std::string prefixWithSeq = prefix + "/" + std::to_string(m_prefixes[prefix]);
-    uint32_t newHash = MurmurHash3(N_HASHCHECK, ParseHex(prefixWithSeq));
+    uint32_t newHash = MurmurHash3(IBLT::N_HASHCHECK, ParseHex(prefixWithSeq));
     m_prefix2hash[prefixWithSeq] = newHash;
     m_hash2prefix[newHash] = prefix;
     m_iblt.insert(newHash);
@@ -438,6 +401,9 @@ namespace psync {
   LogicRepo::satisfyPendingSyncInterests(const std::string& prefix) {
     _LOG_DEBUG("size of pending interest: " << m_pendingEntries.size());
     std::vector <ndn::Name> prefixToErase;
+    // reused across the entries, so they only allocate while growing
+    std::vector<uint32_t> positive;
+    std::vector<uint32_t> negative;
 
     // Satisfy pending interests
     for (auto pendingInterest : m_pendingEntries) {
@@ -448,11 +414,11 @@ namespace psync {
       //PendingEntryInfo entry = pendingInterest.second;
       std::shared_ptr<PendingEntryInfo> entry = pendingInterest.second;
       if (!entry) {continue;}
-      IBLT diff = m_iblt - entry->iblt;
-      std::set<uint32_t> positive;
-      std::set<uint32_t> negative;
+      positive.clear();
+      negative.clear();
 
-      bool peel = diff.listEntries(positive, negative);
+      PeelResult peel = m_iblt.listDifference(entry->iblt, positive, negative, m_peelWorkspace,
+                                              m_threshold);
 
       //printEntries(m_iblt, "MyIBF");
       //printEntries(entry->iblt, "pending IBF");
@@ -463,18 +429,21 @@ namespace psync {
       _LOG_TRACE("Num elements in IBF: " << m_prefixes.size());
       _LOG_TRACE("m_threshold: " << m_threshold << " Total: " << positive.size() + negative.size());
 
-      if (!peel) {
+      if (peel != PEEL_COMPLETE) {
 	_LOG_DEBUG("Cannot peel all the difference between pending IBF and our current IBF");
-	_LOG_DEBUG("Deleted pending sync interest");
-	//this->sendNack(pendingInterest.first);
+	_LOG_DEBUG("Sending all subscribed prefixes");
+	ndn::Name syncDataName = pendingInterest.first;
+	appendIBLT(syncDataName);
+	sendFragmentedData(syncDataName, getFullStateContent(entry->subscription));
 	prefixToErase.push_back(pendingInterest.first);
 	m_scheduler.cancelEvent(entry->expirationEvent);
 	continue;
       }
 
-      if (entry->bf.contains(prefix) || positive.size() + negative.size() >= m_threshold) {
+      bool isSubscribed = entry->subscription.contains(prefix);
+      if (isSubscribed || positive.size() + negative.size() >= m_threshold) {
 	std::string syncContent;
-	if (entry->bf.contains(prefix)) {
+	if (isSubscribed) {
 	  _LOG_DEBUG("sending sync content " << prefix << " " << std::to_string(m_prefixes[prefix]));
 	  syncContent = prefix + " " + std::to_string(m_prefixes[prefix]);
 	} else {
@@ -505,10 +474,21 @@ namespace psync {
     }
   }
 
+  std::string
+  LogicRepo::getFullStateContent(Subscription& subscription) {
+    return psync::getFullStateContent(m_prefixes, m_fullStateContent, m_isFullStateContentCurrent,
+                                      subscription);
+  }
+
+  const std::string&
+  LogicRepo::getFullStateContent() {
+    return psync::getFullStateContent(m_prefixes, m_fullStateContent, m_isFullStateContentCurrent);
+  }
+
   void
   LogicRepo::printEntries(IBLT &iblt, std::string ibltname) {
     std::set <uint32_t> t1, t2;
-    iblt.listEntries(t1, t2);
+    iblt.listEntries(t1, t2, m_peelWorkspace);
 
     std::string combined = "      ";
 
@@ -13,13 +13,14 @@
 
 #include "iblt.hpp"
 #include "bloom-filter.hpp"
+#include "sync-interest.hpp"
 
 namespace psync {
 
   struct PendingEntryInfo {
-    PendingEntryInfo(const bloom_filter& bf, const IBLT& iblt)
-      : bf(bf)
-      , iblt(iblt)
+    PendingEntryInfo(Subscription subscription, IBLT iblt)
+      : subscription(std::move(subscription))
+      , iblt(std::move(iblt))
       , expirationEvent(0)
     {}
 
@@ -28,7 +29,7 @@ namespace psync {
   , iblt(80)
   {}*/
 
-    bloom_filter bf;
+    Subscription subscription;
     IBLT iblt;
     ndn::EventId expirationEvent;
   };
@@ -107,14 +108,32 @@ namespace psync {
       void
       printEntries(IBLT &iblt, std::string ibltname);
 
+      /**
+       * @brief Sync reply content listing every prefix in @p subscription with
+       *        a non-zero sequence number, sent when the difference cannot be peeled
+       */
+      std::string
+      getFullStateContent(Subscription& subscription);
+
+      /**
+       * @brief Same for a consumer subscribed to every prefix, built once and
+       *        shared by all of them until a sequence number changes
+       */
+      const std::string&
+      getFullStateContent();
+
   private:
     IBLT m_iblt;
+    IBLT::PeelWorkspace m_peelWorkspace;
     uint32_t m_expectedNumEntries;
     uint32_t m_threshold;
 
     std::map <std::string, uint32_t> m_prefixes; // prefix and sequence number
     std::map <std::string, uint32_t> m_prefix2hash;
     std::map <uint32_t, std::string> m_hash2prefix;
+    // getFullStateContent(), valid while m_isFullStateContentCurrent
+    std::string m_fullStateContent;
+    bool m_isFullStateContentCurrent;
     //std::map <ndn::Name, PendingEntryInfo> m_pendingEntries;
     std::map <ndn::Name, std::shared_ptr<PendingEntryInfo>> m_pendingEntries;
 
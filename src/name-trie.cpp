@@ -0,0 +1,123 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2018,  The University of Memphis
+ *
+ * This file is part of NLSR (Named-data Link State Routing).
+ * See AUTHORS.md for complete list of NLSR authors and contributors.
+ *
+ * NLSR is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NLSR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NLSR, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include "name-trie.hpp"
+
+namespace psync {
+
+/**
+ * @brief Call @p f with each non-empty '/' separated component of @p name,
+ *        until it returns false
+ */
+template<typename F>
+static void
+forEachComponent(const std::string& name, const F& f)
+{
+  size_t begin = 0;
+  while (begin < name.size()) {
+    size_t end = name.find('/', begin);
+    if (end == std::string::npos) {
+      end = name.size();
+    }
+    if (end > begin && !f(begin, end)) {
+      return;
+    }
+    begin = end + 1;
+  }
+}
+
+NameTrie::NameTrie()
+  : m_nodes(1)
+  , m_size(0)
+{
+}
+
+void
+NameTrie::insert(const std::string& prefix)
+{
+  size_t node = 0;
+  forEachComponent(prefix, [&] (size_t begin, size_t end) {
+    std::string component = prefix.substr(begin, end - begin);
+    auto it = m_nodes[node].children.find(component);
+    if (it != m_nodes[node].children.end()) {
+      node = it->second;
+    }
+    else {
+      // m_nodes may move, do not hold a reference across the push_back
+      size_t child = m_nodes.size();
+      m_nodes.emplace_back();
+      m_nodes[node].children.emplace(std::move(component), child);
+      node = child;
+    }
+    return true;
+  });
+
+  if (!m_nodes[node].isEnd) {
+    m_nodes[node].isEnd = true;
+    ++m_size;
+  }
+}
+
+bool
+NameTrie::hasPrefixOf(const std::string& name) const
+{
+  size_t node = 0;
+  bool isCovered = m_nodes[0].isEnd;
+  std::string component;
+  forEachComponent(name, [&] (size_t begin, size_t end) {
+    component.assign(name, begin, end - begin);
+    auto it = m_nodes[node].children.find(component);
+    if (it == m_nodes[node].children.end()) {
+      return false;
+    }
+    node = it->second;
+    isCovered = m_nodes[node].isEnd;
+    return !isCovered;
+  });
+  return isCovered;
+}
+
+bool
+NameTrie::isPrefixOf(const std::string& prefix, const std::string& name)
+{
+  std::vector<std::pair<size_t, size_t>> prefixComponents;
+  forEachComponent(prefix, [&] (size_t begin, size_t end) {
+    prefixComponents.emplace_back(begin, end);
+    return true;
+  });
+
+  size_t i = 0;
+  bool isMatch = true;
+  forEachComponent(name, [&] (size_t begin, size_t end) {
+    if (i == prefixComponents.size()) {
+      return false;
+    }
+    const auto& component = prefixComponents[i];
+    if (name.compare(begin, end - begin, prefix, component.first,
+                     component.second - component.first) != 0) {
+      isMatch = false;
+      return false;
+    }
+    ++i;
+    return true;
+  });
+  return isMatch && i == prefixComponents.size();
+}
+
+} // namespace psync
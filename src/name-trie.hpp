@@ -0,0 +1,87 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2018,  The University of Memphis
+ *
+ * This file is part of NLSR (Named-data Link State Routing).
+ * See AUTHORS.md for complete list of NLSR authors and contributors.
+ *
+ * NLSR is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NLSR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NLSR, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef PSYNC_NAME_TRIE_HPP
+#define PSYNC_NAME_TRIE_HPP
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace psync {
+
+/**
+ * @brief Set of name prefixes such as "/plant/line3", stored as a trie of
+ *        their '/' separated components
+ *
+ * Tells whether any of them is a prefix of a name, component by component,
+ * in as many steps as the name has components: "/plant/line3" covers
+ * "/plant/line3" and "/plant/line3/pump2" but not "/plant/line30". "/"
+ * covers every name.
+ */
+class NameTrie
+{
+public:
+  NameTrie();
+
+  void
+  insert(const std::string& prefix);
+
+  bool
+  empty() const
+  {
+    return m_size == 0;
+  }
+
+  /// Number of distinct prefixes inserted
+  size_t
+  size() const
+  {
+    return m_size;
+  }
+
+  /**
+   * @brief Whether @p name is one of the prefixes or under one of them
+   */
+  bool
+  hasPrefixOf(const std::string& name) const;
+
+  /**
+   * @brief Same test for a single prefix, without building a trie
+   */
+  static bool
+  isPrefixOf(const std::string& prefix, const std::string& name);
+
+private:
+  struct Node
+  {
+    std::map<std::string, size_t> children;
+    bool isEnd = false;
+  };
+
+  // m_nodes[0] is the root, children are indices into m_nodes so that the
+  // trie copies as plain values
+  std::vector<Node> m_nodes;
+  size_t m_size;
+};
+
+} // namespace psync
+
+#endif // PSYNC_NAME_TRIE_HPP
@@ -0,0 +1,238 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2018,  The University of Memphis
+ *
+ * This file is part of NLSR (Named-data Link State Routing).
+ * See AUTHORS.md for complete list of NLSR authors and contributors.
+ *
+ * NLSR is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NLSR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NLSR, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include "rateless-iblt.hpp"
+#include "iblt.hpp"
+#include "simd.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace psync {
+
+const size_t RatelessIBLT::SYMBOL_SIZE;
+
+// Indices past this are never materialized
+static const uint64_t INDEX_LIMIT = uint64_t(1) << 48;
+
+/**
+ * @brief Sequence of symbol indices a key is added into
+ *
+ * Index gaps are drawn so that symbol i holds each key with probability
+ * about 1/(1 + i/2), as in the paper.
+ */
+class SymbolMapping
+{
+public:
+  explicit
+  SymbolMapping(uint32_t key)
+    : m_prng((static_cast<uint64_t>(MurmurHash3(0x1F, key)) << 32) | MurmurHash3(0x2F, key))
+    , m_index(0)
+  {
+  }
+
+  uint64_t
+  getIndex() const
+  {
+    return m_index;
+  }
+
+  void
+  next()
+  {
+    m_prng *= 0xda942042e4dd58b5ULL;
+    double step = std::ceil((m_index + 1.5) *
+                            (4294967296.0 / std::sqrt(static_cast<double>(m_prng) + 1) - 1));
+    if (step >= static_cast<double>(INDEX_LIMIT - m_index)) {
+      m_index = INDEX_LIMIT;
+    }
+    else {
+      m_index += std::max(step, 1.0);
+    }
+  }
+
+private:
+  uint64_t m_prng;
+  uint64_t m_index;
+};
+
+/**
+ * @brief Add @p key with @p sign into the symbols of [begin, end) it maps to,
+ *        calling @p onUpdate with each index touched
+ */
+template<typename OnUpdate>
+static void
+applyKey(uint32_t key, int32_t sign, int32_t* count, uint32_t* keySum, uint32_t* keyCheck,
+         size_t begin, size_t end, const OnUpdate& onUpdate)
+{
+  uint32_t check = MurmurHash3(IBLT::N_HASHCHECK, key);
+  for (SymbolMapping mapping(key); mapping.getIndex() < end; mapping.next()) {
+    size_t i = mapping.getIndex();
+    if (i < begin) {
+      continue;
+    }
+    count[i] += sign;
+    keySum[i] ^= key;
+    keyCheck[i] ^= check;
+    onUpdate(i);
+  }
+}
+
+static void
+ignoreIndex(size_t)
+{
+}
+
+RatelessIBLT::RatelessIBLT()
+  : m_version(0)
+{
+}
+
+void
+RatelessIBLT::insert(uint32_t key)
+{
+  if (!m_keys.insert(key).second) {
+    return;
+  }
+  ++m_version;
+  applyKey(key, 1, m_count.data(), m_keySum.data(), m_keyCheck.data(),
+           0, m_count.size(), ignoreIndex);
+}
+
+void
+RatelessIBLT::erase(uint32_t key)
+{
+  if (m_keys.erase(key) == 0) {
+    return;
+  }
+  ++m_version;
+  applyKey(key, -1, m_count.data(), m_keySum.data(), m_keyCheck.data(),
+           0, m_count.size(), ignoreIndex);
+}
+
+void
+RatelessIBLT::extend(size_t n)
+{
+  size_t begin = m_count.size();
+  if (n <= begin) {
+    return;
+  }
+
+  m_count.resize(n, 0);
+  m_keySum.resize(n, 0);
+  m_keyCheck.resize(n, 0);
+
+  for (uint32_t key : m_keys) {
+    applyKey(key, 1, m_count.data(), m_keySum.data(), m_keyCheck.data(),
+             begin, n, ignoreIndex);
+  }
+}
+
+std::vector<uint8_t>
+RatelessIBLT::encodeSymbols(size_t first, size_t n)
+{
+  extend(first + n);
+
+  std::vector<uint8_t> buffer(SYMBOL_SIZE * n);
+  simd::encodeCells(buffer.data(), m_count.data() + first, m_keySum.data() + first,
+                    m_keyCheck.data() + first, n);
+  return buffer;
+}
+
+RatelessDecoder::RatelessDecoder(RatelessIBLT& local)
+  : m_local(local)
+{
+}
+
+bool
+RatelessDecoder::addSymbols(const uint8_t* buffer, size_t n)
+{
+  size_t begin = m_count.size();
+  size_t end = begin + n;
+
+  m_count.resize(end);
+  m_keySum.resize(end);
+  m_keyCheck.resize(end);
+  simd::decodeCells(buffer, m_count.data() + begin, m_keySum.data() + begin,
+                    m_keyCheck.data() + begin, n);
+
+  m_local.extend(end);
+  for (size_t i = begin; i < end; i++) {
+    m_count[i] = m_local.m_count[i] - m_count[i];
+    m_keySum[i] ^= m_local.m_keySum[i];
+    m_keyCheck[i] ^= m_local.m_keyCheck[i];
+  }
+
+  // Keys peeled from earlier blocks are still in the new symbols
+  for (uint32_t key : m_positive) {
+    applyKey(key, -1, m_count.data(), m_keySum.data(), m_keyCheck.data(),
+             begin, end, ignoreIndex);
+  }
+  for (uint32_t key : m_negative) {
+    applyKey(key, 1, m_count.data(), m_keySum.data(), m_keyCheck.data(),
+             begin, end, ignoreIndex);
+  }
+
+  auto isPure = [this] (size_t i) {
+    return (m_count[i] == 1 || m_count[i] == -1) &&
+           m_keyCheck[i] == MurmurHash3(IBLT::N_HASHCHECK, m_keySum[i]);
+  };
+
+  m_queue.clear();
+  for (size_t i = begin; i < end; i++) {
+    if (isPure(i)) {
+      m_queue.push_back(i);
+    }
+  }
+
+  while (!m_queue.empty()) {
+    size_t i = m_queue.back();
+    m_queue.pop_back();
+    if (!isPure(i)) {
+      continue;
+    }
+
+    uint32_t key = m_keySum[i];
+    int32_t sign = m_count[i];
+    if (sign == 1) {
+      m_positive.insert(key);
+    }
+    else {
+      m_negative.insert(key);
+    }
+
+    applyKey(key, -sign, m_count.data(), m_keySum.data(), m_keyCheck.data(), 0, end,
+             [&] (size_t j) {
+               if (isPure(j)) {
+                 m_queue.push_back(j);
+               }
+             });
+  }
+
+  return isDecoded();
+}
+
+bool
+RatelessDecoder::isDecoded() const
+{
+  return !m_count.empty() && m_count[0] == 0 && m_keySum[0] == 0 && m_keyCheck[0] == 0;
+}
+
+} // namespace psync
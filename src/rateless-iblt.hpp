@@ -0,0 +1,147 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2018,  The University of Memphis
+ *
+ * This file is part of NLSR (Named-data Link State Routing).
+ * See AUTHORS.md for complete list of NLSR authors and contributors.
+ *
+ * NLSR is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NLSR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NLSR, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef PSYNC_RATELESS_IBLT_HPP
+#define PSYNC_RATELESS_IBLT_HPP
+
+#include <inttypes.h>
+#include <cstddef>
+#include <set>
+#include <vector>
+
+namespace psync {
+
+/**
+ * @brief Rateless IBLT encoder (Yang et al., "Practical Rateless Set Reconciliation")
+ *
+ * Produces an endless sequence of coded symbols (count, keySum, keyCheck) over
+ * a set of keys. Every key is added into symbol 0 and then into symbols whose
+ * indices grow roughly geometrically, so the first m symbols of two sets
+ * decode a difference of about m/1.4 keys whatever its size: the receiver
+ * keeps asking for more until it decodes instead of starting over.
+ *
+ * Symbols are materialized only when first requested and are then kept up to
+ * date by insert and erase.
+ */
+class RatelessIBLT
+{
+public:
+  /// Size of an encoded symbol, the 12-byte IBLT cell layout
+  static const size_t SYMBOL_SIZE = 12;
+
+  RatelessIBLT();
+
+  void
+  insert(uint32_t key);
+
+  void
+  erase(uint32_t key);
+
+  /**
+   * @brief Counter bumped by every insert and erase
+   *
+   * A RatelessDecoder is only valid while the local set does not change.
+   */
+  uint64_t
+  getVersion() const
+  {
+    return m_version;
+  }
+
+  /**
+   * @brief Wire encoding of symbols [first, first + n)
+   */
+  std::vector<uint8_t>
+  encodeSymbols(size_t first, size_t n);
+
+private:
+  void
+  extend(size_t n);
+
+private:
+  std::set<uint32_t> m_keys;
+  uint64_t m_version;
+
+  std::vector<int32_t> m_count;
+  std::vector<uint32_t> m_keySum;
+  std::vector<uint32_t> m_keyCheck;
+
+  friend class RatelessDecoder;
+};
+
+/**
+ * @brief Decodes the difference between a local RatelessIBLT and the symbols
+ *        received from a peer
+ *
+ * Symbols are added in order, block by block. Symbol 0 holds every key, so
+ * the difference is fully decoded once it has been peeled to zero.
+ */
+class RatelessDecoder
+{
+public:
+  explicit
+  RatelessDecoder(RatelessIBLT& local);
+
+  /**
+   * @brief Append @p n remote symbols in wire format and peel what they free
+   *
+   * @return whether the difference is now fully decoded
+   */
+  bool
+  addSymbols(const uint8_t* buffer, size_t n);
+
+  bool
+  isDecoded() const;
+
+  size_t
+  getNumSymbols() const
+  {
+    return m_count.size();
+  }
+
+  /// Keys only the local set has
+  const std::set<uint32_t>&
+  getPositive() const
+  {
+    return m_positive;
+  }
+
+  /// Keys only the remote set has
+  const std::set<uint32_t>&
+  getNegative() const
+  {
+    return m_negative;
+  }
+
+private:
+  RatelessIBLT& m_local;
+
+  // local minus remote
+  std::vector<int32_t> m_count;
+  std::vector<uint32_t> m_keySum;
+  std::vector<uint32_t> m_keyCheck;
+
+  std::set<uint32_t> m_positive;
+  std::set<uint32_t> m_negative;
+  std::vector<size_t> m_queue;
+};
+
+} // namespace psync
+
+#endif // PSYNC_RATELESS_IBLT_HPP
@@ -0,0 +1,551 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2018,  The University of Memphis
+ *
+ * This file is part of NLSR (Named-data Link State Routing).
+ * See AUTHORS.md for complete list of NLSR authors and contributors.
+ *
+ * NLSR is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NLSR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NLSR, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include "simd.hpp"
+
+#include <cstring>
+#include <type_traits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PSYNC_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+namespace psync {
+namespace simd {
+
+namespace scalar {
+
+template<typename T>
+static void
+subtract(T* dst, const T* a, const T* b, size_t n)
+{
+  typedef typename std::make_unsigned<T>::type U;
+  for (size_t i = 0; i < n; i++) {
+    // wrap around like the lane arithmetic of the vector versions
+    dst[i] = static_cast<T>(static_cast<U>(static_cast<U>(a[i]) - static_cast<U>(b[i])));
+  }
+}
+
+static void
+exclusiveOr(void* dst, const void* a, const void* b, size_t nBytes)
+{
+  uint8_t* d = static_cast<uint8_t*>(dst);
+  const uint8_t* x = static_cast<const uint8_t*>(a);
+  const uint8_t* y = static_cast<const uint8_t*>(b);
+  for (size_t i = 0; i < nBytes; i++) {
+    d[i] = x[i] ^ y[i];
+  }
+}
+
+static bool
+equal(const void* a, const void* b, size_t nBytes)
+{
+  return std::memcmp(a, b, nBytes) == 0;
+}
+
+static bool
+isZero(const void* a, size_t nBytes)
+{
+  const uint8_t* x = static_cast<const uint8_t*>(a);
+  uint8_t acc = 0;
+  for (size_t i = 0; i < nBytes; i++) {
+    acc |= x[i];
+  }
+  return acc == 0;
+}
+
+static bool
+containsAll(const void* set, const void* subset, size_t nBytes)
+{
+  const uint8_t* x = static_cast<const uint8_t*>(set);
+  const uint8_t* y = static_cast<const uint8_t*>(subset);
+  uint8_t missing = 0;
+  for (size_t i = 0; i < nBytes; i++) {
+    missing |= y[i] & ~x[i];
+  }
+  return missing == 0;
+}
+
+static void
+putUint32(uint8_t* out, uint32_t value)
+{
+  out[0] = 0xFF & value;
+  out[1] = 0xFF & (value >> 8);
+  out[2] = 0xFF & (value >> 16);
+  out[3] = 0xFF & (value >> 24);
+}
+
+static uint32_t
+getUint32(const uint8_t* in)
+{
+  return (static_cast<uint32_t>(in[3]) << 24) + (static_cast<uint32_t>(in[2]) << 16) +
+         (static_cast<uint32_t>(in[1]) << 8) + in[0];
+}
+
+static void
+encodeCells(uint8_t* out, const int32_t* count, const uint32_t* keySum,
+            const uint32_t* keyCheck, size_t n)
+{
+  for (size_t i = 0; i < n; i++) {
+    putUint32(out + i*12, static_cast<uint32_t>(count[i]));
+    putUint32(out + i*12 + 4, keySum[i]);
+    putUint32(out + i*12 + 8, keyCheck[i]);
+  }
+}
+
+static void
+decodeCells(const uint8_t* in, int32_t* count, uint32_t* keySum,
+            uint32_t* keyCheck, size_t n)
+{
+  for (size_t i = 0; i < n; i++) {
+    count[i] = static_cast<int32_t>(getUint32(in + i*12));
+    keySum[i] = getUint32(in + i*12 + 4);
+    keyCheck[i] = getUint32(in + i*12 + 8);
+  }
+}
+
+static void
+subtractEncodedCells(const uint8_t* in, const int32_t* count, const uint32_t* keySum,
+                     const uint32_t* keyCheck, int32_t* outCount, uint32_t* outKeySum,
+                     uint32_t* outKeyCheck, size_t n)
+{
+  for (size_t i = 0; i < n; i++) {
+    outCount[i] = static_cast<int32_t>(static_cast<uint32_t>(count[i]) - getUint32(in + i*12));
+    outKeySum[i] = keySum[i] ^ getUint32(in + i*12 + 4);
+    outKeyCheck[i] = keyCheck[i] ^ getUint32(in + i*12 + 8);
+  }
+}
+
+} // namespace scalar
+
+#ifdef PSYNC_SIMD_X86
+
+namespace sse2 {
+
+#define PSYNC_SHUFFLE(a, b, imm) \
+  _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), imm))
+
+__attribute__((target("sse2"))) static inline __m128i
+sub(__m128i x, __m128i y, int8_t)
+{
+  return _mm_sub_epi8(x, y);
+}
+
+__attribute__((target("sse2"))) static inline __m128i
+sub(__m128i x, __m128i y, int16_t)
+{
+  return _mm_sub_epi16(x, y);
+}
+
+__attribute__((target("sse2"))) static inline __m128i
+sub(__m128i x, __m128i y, int32_t)
+{
+  return _mm_sub_epi32(x, y);
+}
+
+template<typename T>
+__attribute__((target("sse2"))) static void
+subtract(T* dst, const T* a, const T* b, size_t n)
+{
+  const size_t lanes = sizeof(__m128i) / sizeof(T);
+  size_t i = 0;
+  for (; i + lanes <= n; i += lanes) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+    __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), sub(x, y, T()));
+  }
+  scalar::subtract(dst + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("sse2"))) static void
+exclusiveOr(void* dst, const void* a, const void* b, size_t nBytes)
+{
+  uint8_t* d = static_cast<uint8_t*>(dst);
+  const uint8_t* x = static_cast<const uint8_t*>(a);
+  const uint8_t* y = static_cast<const uint8_t*>(b);
+  size_t i = 0;
+  for (; i + 16 <= nBytes; i += 16) {
+    __m128i u = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i));
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(d + i), _mm_xor_si128(u, v));
+  }
+  scalar::exclusiveOr(d + i, x + i, y + i, nBytes - i);
+}
+
+__attribute__((target("sse2"))) static bool
+equal(const void* a, const void* b, size_t nBytes)
+{
+  const uint8_t* x = static_cast<const uint8_t*>(a);
+  const uint8_t* y = static_cast<const uint8_t*>(b);
+  size_t i = 0;
+  for (; i + 16 <= nBytes; i += 16) {
+    __m128i u = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i));
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + i));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(u, v)) != 0xFFFF) {
+      return false;
+    }
+  }
+  return scalar::equal(x + i, y + i, nBytes - i);
+}
+
+__attribute__((target("sse2"))) static bool
+isZero(const void* a, size_t nBytes)
+{
+  const uint8_t* x = static_cast<const uint8_t*>(a);
+  __m128i acc = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 16 <= nBytes; i += 16) {
+    acc = _mm_or_si128(acc, _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i)));
+  }
+  if (_mm_movemask_epi8(_mm_cmpeq_epi8(acc, _mm_setzero_si128())) != 0xFFFF) {
+    return false;
+  }
+  return scalar::isZero(x + i, nBytes - i);
+}
+
+__attribute__((target("sse2"))) static bool
+containsAll(const void* set, const void* subset, size_t nBytes)
+{
+  const uint8_t* x = static_cast<const uint8_t*>(set);
+  const uint8_t* y = static_cast<const uint8_t*>(subset);
+  __m128i missing = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 16 <= nBytes; i += 16) {
+    __m128i u = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i));
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + i));
+    missing = _mm_or_si128(missing, _mm_andnot_si128(u, v));
+  }
+  if (_mm_movemask_epi8(_mm_cmpeq_epi8(missing, _mm_setzero_si128())) != 0xFFFF) {
+    return false;
+  }
+  return scalar::containsAll(x + i, y + i, nBytes - i);
+}
+
+// Four cells at a time: three registers of counts, keySums and keyChecks
+// are shuffled into three registers of wire bytes
+// [c0 s0 k0 c1] [s1 k1 c2 s2] [k2 c3 s3 k3] (little-endian hosts only)
+__attribute__((target("sse2"))) static void
+encodeCells(uint8_t* out, const int32_t* count, const uint32_t* keySum,
+            const uint32_t* keyCheck, size_t n)
+{
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(count + i));
+    __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keySum + i));
+    __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keyCheck + i));
+
+    __m128i csLo = _mm_unpacklo_epi32(c, s);                       // c0 s0 c1 s1
+    __m128i csHi = _mm_unpackhi_epi32(c, s);                       // c2 s2 c3 s3
+    __m128i kc = PSYNC_SHUFFLE(k, csLo, _MM_SHUFFLE(2, 2, 0, 0));  // k0 k0 c1 c1
+    __m128i sk = PSYNC_SHUFFLE(csLo, k, _MM_SHUFFLE(1, 1, 3, 3));  // s1 s1 k1 k1
+    __m128i kc2 = PSYNC_SHUFFLE(k, csHi, _MM_SHUFFLE(2, 2, 2, 2)); // k2 k2 c3 c3
+    __m128i sk2 = PSYNC_SHUFFLE(csHi, k, _MM_SHUFFLE(3, 3, 3, 3)); // s3 s3 k3 k3
+
+    __m128i* dst = reinterpret_cast<__m128i*>(out + i*12);
+    _mm_storeu_si128(dst, PSYNC_SHUFFLE(csLo, kc, _MM_SHUFFLE(2, 0, 1, 0)));
+    _mm_storeu_si128(dst + 1, PSYNC_SHUFFLE(sk, csHi, _MM_SHUFFLE(1, 0, 2, 0)));
+    _mm_storeu_si128(dst + 2, PSYNC_SHUFFLE(kc2, sk2, _MM_SHUFFLE(2, 0, 2, 0)));
+  }
+  scalar::encodeCells(out + i*12, count + i, keySum + i, keyCheck + i, n - i);
+}
+
+__attribute__((target("sse2"))) static void
+decodeCells(const uint8_t* in, int32_t* count, uint32_t* keySum,
+            uint32_t* keyCheck, size_t n)
+{
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m128i* src = reinterpret_cast<const __m128i*>(in + i*12);
+    __m128i o0 = _mm_loadu_si128(src);     // c0 s0 k0 c1
+    __m128i o1 = _mm_loadu_si128(src + 1); // s1 k1 c2 s2
+    __m128i o2 = _mm_loadu_si128(src + 2); // k2 c3 s3 k3
+
+    __m128i cc = PSYNC_SHUFFLE(o1, o2, _MM_SHUFFLE(1, 1, 2, 2)); // c2 c2 c3 c3
+    __m128i ss = PSYNC_SHUFFLE(o0, o1, _MM_SHUFFLE(0, 0, 1, 1)); // s0 s0 s1 s1
+    __m128i ss2 = PSYNC_SHUFFLE(o1, o2, _MM_SHUFFLE(2, 2, 3, 3)); // s2 s2 s3 s3
+    __m128i kk = PSYNC_SHUFFLE(o0, o1, _MM_SHUFFLE(1, 1, 2, 2)); // k0 k0 k1 k1
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(count + i),
+                     PSYNC_SHUFFLE(o0, cc, _MM_SHUFFLE(2, 0, 3, 0)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(keySum + i),
+                     PSYNC_SHUFFLE(ss, ss2, _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(keyCheck + i),
+                     PSYNC_SHUFFLE(kk, o2, _MM_SHUFFLE(3, 0, 2, 0)));
+  }
+  scalar::decodeCells(in + i*12, count + i, keySum + i, keyCheck + i, n - i);
+}
+
+__attribute__((target("sse2"))) static void
+subtractEncodedCells(const uint8_t* in, const int32_t* count, const uint32_t* keySum,
+                     const uint32_t* keyCheck, int32_t* outCount, uint32_t* outKeySum,
+                     uint32_t* outKeyCheck, size_t n)
+{
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m128i* src = reinterpret_cast<const __m128i*>(in + i*12);
+    __m128i o0 = _mm_loadu_si128(src);     // c0 s0 k0 c1
+    __m128i o1 = _mm_loadu_si128(src + 1); // s1 k1 c2 s2
+    __m128i o2 = _mm_loadu_si128(src + 2); // k2 c3 s3 k3
+
+    __m128i cc = PSYNC_SHUFFLE(o1, o2, _MM_SHUFFLE(1, 1, 2, 2)); // c2 c2 c3 c3
+    __m128i ss = PSYNC_SHUFFLE(o0, o1, _MM_SHUFFLE(0, 0, 1, 1)); // s0 s0 s1 s1
+    __m128i ss2 = PSYNC_SHUFFLE(o1, o2, _MM_SHUFFLE(2, 2, 3, 3)); // s2 s2 s3 s3
+    __m128i kk = PSYNC_SHUFFLE(o0, o1, _MM_SHUFFLE(1, 1, 2, 2)); // k0 k0 k1 k1
+
+    __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(count + i));
+    __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keySum + i));
+    __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keyCheck + i));
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(outCount + i),
+                     _mm_sub_epi32(c, PSYNC_SHUFFLE(o0, cc, _MM_SHUFFLE(2, 0, 3, 0))));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(outKeySum + i),
+                     _mm_xor_si128(s, PSYNC_SHUFFLE(ss, ss2, _MM_SHUFFLE(2, 0, 2, 0))));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(outKeyCheck + i),
+                     _mm_xor_si128(k, PSYNC_SHUFFLE(kk, o2, _MM_SHUFFLE(3, 0, 2, 0))));
+  }
+  scalar::subtractEncodedCells(in + i*12, count + i, keySum + i, keyCheck + i,
+                               outCount + i, outKeySum + i, outKeyCheck + i, n - i);
+}
+
+#undef PSYNC_SHUFFLE
+
+} // namespace sse2
+
+namespace avx2 {
+
+__attribute__((target("avx2"))) static inline __m256i
+sub(__m256i x, __m256i y, int8_t)
+{
+  return _mm256_sub_epi8(x, y);
+}
+
+__attribute__((target("avx2"))) static inline __m256i
+sub(__m256i x, __m256i y, int16_t)
+{
+  return _mm256_sub_epi16(x, y);
+}
+
+__attribute__((target("avx2"))) static inline __m256i
+sub(__m256i x, __m256i y, int32_t)
+{
+  return _mm256_sub_epi32(x, y);
+}
+
+template<typename T>
+__attribute__((target("avx2"))) static void
+subtract(T* dst, const T* a, const T* b, size_t n)
+{
+  const size_t lanes = sizeof(__m256i) / sizeof(T);
+  size_t i = 0;
+  for (; i + lanes <= n; i += lanes) {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+    __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), sub(x, y, T()));
+  }
+  sse2::subtract(dst + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2"))) static void
+exclusiveOr(void* dst, const void* a, const void* b, size_t nBytes)
+{
+  uint8_t* d = static_cast<uint8_t*>(dst);
+  const uint8_t* x = static_cast<const uint8_t*>(a);
+  const uint8_t* y = static_cast<const uint8_t*>(b);
+  size_t i = 0;
+  for (; i + 32 <= nBytes; i += 32) {
+    __m256i u = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i));
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(y + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(d + i), _mm256_xor_si256(u, v));
+  }
+  sse2::exclusiveOr(d + i, x + i, y + i, nBytes - i);
+}
+
+__attribute__((target("avx2"))) static bool
+equal(const void* a, const void* b, size_t nBytes)
+{
+  const uint8_t* x = static_cast<const uint8_t*>(a);
+  const uint8_t* y = static_cast<const uint8_t*>(b);
+  size_t i = 0;
+  for (; i + 32 <= nBytes; i += 32) {
+    __m256i u = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i));
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(y + i));
+    if (!_mm256_testc_si256(_mm256_cmpeq_epi8(u, v), _mm256_set1_epi8(-1))) {
+      return false;
+    }
+  }
+  return sse2::equal(x + i, y + i, nBytes - i);
+}
+
+__attribute__((target("avx2"))) static bool
+isZero(const void* a, size_t nBytes)
+{
+  const uint8_t* x = static_cast<const uint8_t*>(a);
+  __m256i acc = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 32 <= nBytes; i += 32) {
+    acc = _mm256_or_si256(acc, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i)));
+  }
+  if (!_mm256_testz_si256(acc, acc)) {
+    return false;
+  }
+  return sse2::isZero(x + i, nBytes - i);
+}
+
+__attribute__((target("avx2"))) static bool
+containsAll(const void* set, const void* subset, size_t nBytes)
+{
+  const uint8_t* x = static_cast<const uint8_t*>(set);
+  const uint8_t* y = static_cast<const uint8_t*>(subset);
+  size_t i = 0;
+  for (; i + 32 <= nBytes; i += 32) {
+    __m256i u = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i));
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(y + i));
+    // testc is set when (~u & v) == 0
+    if (!_mm256_testc_si256(u, v)) {
+      return false;
+    }
+  }
+  return sse2::containsAll(x + i, y + i, nBytes - i);
+}
+
+} // namespace avx2
+
+#endif // PSYNC_SIMD_X86
+
+struct Kernels
+{
+  void (*subtract8)(int8_t*, const int8_t*, const int8_t*, size_t);
+  void (*subtract16)(int16_t*, const int16_t*, const int16_t*, size_t);
+  void (*subtract32)(int32_t*, const int32_t*, const int32_t*, size_t);
+  void (*exclusiveOr)(void*, const void*, const void*, size_t);
+  bool (*equal)(const void*, const void*, size_t);
+  bool (*isZero)(const void*, size_t);
+  bool (*containsAll)(const void*, const void*, size_t);
+  void (*encodeCells)(uint8_t*, const int32_t*, const uint32_t*, const uint32_t*, size_t);
+  void (*decodeCells)(const uint8_t*, int32_t*, uint32_t*, uint32_t*, size_t);
+  void (*subtractEncodedCells)(const uint8_t*, const int32_t*, const uint32_t*, const uint32_t*,
+                               int32_t*, uint32_t*, uint32_t*, size_t);
+  const char* name;
+};
+
+static Kernels
+selectKernels()
+{
+#ifdef PSYNC_SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    // The 12-byte cell stride does not map onto 32-byte lanes,
+    // so the wire encoding stays on the SSE2 shuffles
+    return Kernels{avx2::subtract<int8_t>, avx2::subtract<int16_t>, avx2::subtract<int32_t>,
+                   avx2::exclusiveOr, avx2::equal, avx2::isZero, avx2::containsAll,
+                   sse2::encodeCells, sse2::decodeCells, sse2::subtractEncodedCells, "avx2"};
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return Kernels{sse2::subtract<int8_t>, sse2::subtract<int16_t>, sse2::subtract<int32_t>,
+                   sse2::exclusiveOr, sse2::equal, sse2::isZero, sse2::containsAll,
+                   sse2::encodeCells, sse2::decodeCells, sse2::subtractEncodedCells, "sse2"};
+  }
+#endif
+  return Kernels{scalar::subtract<int8_t>, scalar::subtract<int16_t>, scalar::subtract<int32_t>,
+                 scalar::exclusiveOr, scalar::equal, scalar::isZero, scalar::containsAll,
+                 scalar::encodeCells, scalar::decodeCells, scalar::subtractEncodedCells,
+                 "scalar"};
+}
+
+static const Kernels&
+getKernels()
+{
+  static const Kernels kernels = selectKernels();
+  return kernels;
+}
+
+void
+subtract(int8_t* dst, const int8_t* a, const int8_t* b, size_t n)
+{
+  getKernels().subtract8(dst, a, b, n);
+}
+
+void
+subtract(int16_t* dst, const int16_t* a, const int16_t* b, size_t n)
+{
+  getKernels().subtract16(dst, a, b, n);
+}
+
+void
+subtract(int32_t* dst, const int32_t* a, const int32_t* b, size_t n)
+{
+  getKernels().subtract32(dst, a, b, n);
+}
+
+void
+exclusiveOr(void* dst, const void* a, const void* b, size_t nBytes)
+{
+  getKernels().exclusiveOr(dst, a, b, nBytes);
+}
+
+bool
+equal(const void* a, const void* b, size_t nBytes)
+{
+  return getKernels().equal(a, b, nBytes);
+}
+
+bool
+isZero(const void* a, size_t nBytes)
+{
+  return getKernels().isZero(a, nBytes);
+}
+
+bool
+containsAll(const void* set, const void* subset, size_t nBytes)
+{
+  return getKernels().containsAll(set, subset, nBytes);
+}
+
+void
+encodeCells(uint8_t* out, const int32_t* count, const uint32_t* keySum,
+            const uint32_t* keyCheck, size_t n)
+{
+  getKernels().encodeCells(out, count, keySum, keyCheck, n);
+}
+
+void
+decodeCells(const uint8_t* in, int32_t* count, uint32_t* keySum,
+            uint32_t* keyCheck, size_t n)
+{
+  getKernels().decodeCells(in, count, keySum, keyCheck, n);
+}
+
+void
+subtractEncodedCells(const uint8_t* in, const int32_t* count, const uint32_t* keySum,
+                     const uint32_t* keyCheck, int32_t* outCount, uint32_t* outKeySum,
+                     uint32_t* outKeyCheck, size_t n)
+{
+  getKernels().subtractEncodedCells(in, count, keySum, keyCheck,
+                                    outCount, outKeySum, outKeyCheck, n);
+}
+
+const char*
+getImplementation()
+{
+  return getKernels().name;
+}
+
+} // namespace simd
+} // namespace psync
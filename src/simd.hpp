@@ -0,0 +1,103 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2018,  The University of Memphis
+ *
+ * This file is part of NLSR (Named-data Link State Routing).
+ * See AUTHORS.md for complete list of NLSR authors and contributors.
+ *
+ * NLSR is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NLSR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NLSR, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef PSYNC_SIMD_HPP
+#define PSYNC_SIMD_HPP
+
+#include <boost/align/aligned_allocator.hpp>
+
+#include <inttypes.h>
+#include <cstddef>
+#include <vector>
+
+namespace psync {
+namespace simd {
+
+/**
+ * @brief Alignment of the arrays handed to the kernels below (one AVX2 register)
+ */
+static const size_t ALIGNMENT = 32;
+
+template<typename T>
+using AlignedVector = std::vector<T, boost::alignment::aligned_allocator<T, ALIGNMENT>>;
+
+/**
+ * @brief Kernels for the IBLT cell arrays
+ *
+ * The best implementation the CPU supports (AVX2, SSE2 or plain C++) is picked
+ * the first time any of these is called. Inputs do not need to be aligned,
+ * but AlignedVector storage avoids split loads.
+ */
+
+/// dst[i] = a[i] - b[i] (wrapping) for @p n elements, @p dst may alias @p a or @p b
+void
+subtract(int8_t* dst, const int8_t* a, const int8_t* b, size_t n);
+
+void
+subtract(int16_t* dst, const int16_t* a, const int16_t* b, size_t n);
+
+void
+subtract(int32_t* dst, const int32_t* a, const int32_t* b, size_t n);
+
+/// dst[i] = a[i] ^ b[i] over @p nBytes bytes, @p dst may alias @p a
+void
+exclusiveOr(void* dst, const void* a, const void* b, size_t nBytes);
+
+bool
+equal(const void* a, const void* b, size_t nBytes);
+
+bool
+isZero(const void* a, size_t nBytes);
+
+/// true if every bit set in @p subset is also set in @p set, over @p nBytes bytes
+bool
+containsAll(const void* set, const void* subset, size_t nBytes);
+
+/**
+ * @brief Interleave @p n cells into the 12-byte little-endian wire layout
+ *        (count, keySum, keyCheck)
+ */
+void
+encodeCells(uint8_t* out, const int32_t* count, const uint32_t* keySum,
+            const uint32_t* keyCheck, size_t n);
+
+/// Inverse of encodeCells
+void
+decodeCells(const uint8_t* in, int32_t* count, uint32_t* keySum,
+            uint32_t* keyCheck, size_t n);
+
+/**
+ * @brief Subtract @p n cells in wire layout from (count, keySum, keyCheck)
+ *
+ * Same as decodeCells into the out arrays followed by subtract and exclusiveOr,
+ * in a single pass over @p in. The out arrays may alias the inputs.
+ */
+void
+subtractEncodedCells(const uint8_t* in, const int32_t* count, const uint32_t* keySum,
+                     const uint32_t* keyCheck, int32_t* outCount, uint32_t* outKeySum,
+                     uint32_t* outKeyCheck, size_t n);
+
+/// Name of the selected implementation, "avx2", "sse2" or "scalar"
+const char*
+getImplementation();
+
+} // namespace simd
+} // namespace psync
+
+#endif // PSYNC_SIMD_HPP
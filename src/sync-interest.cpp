@@ -0,0 +1,208 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2018,  The University of Memphis
+ *
+ * This file is part of NLSR (Named-data Link State Routing).
+ * See AUTHORS.md for complete list of NLSR authors and contributors.
+ *
+ * NLSR is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NLSR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NLSR, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include "sync-interest.hpp"
+#include "iblt.hpp"
+#include "simd.hpp"
+#include "util.hpp"
+
+namespace psync {
+
+const std::string&
+getFullStateContent(const std::map<std::string, uint32_t>& prefixes,
+                    std::string& content, bool& isCurrent)
+{
+  if (isCurrent) {
+    return content;
+  }
+
+  content.clear();
+  for (const auto& prefixAndSeq : prefixes) {
+    // Don't sync up sequence number zero
+    if (prefixAndSeq.second != 0) {
+      content += prefixAndSeq.first + " " + std::to_string(prefixAndSeq.second) + "\n";
+    }
+  }
+  isCurrent = true;
+  return content;
+}
+
+std::string
+getFullStateContent(const std::map<std::string, uint32_t>& prefixes,
+                    std::string& content, bool& isCurrent, Subscription& subscription)
+{
+  // shared by every consumer subscribed to everything
+  if (subscription.isSubscribeAll) {
+    return getFullStateContent(prefixes, content, isCurrent);
+  }
+
+  std::string subscribed;
+  for (const auto& prefixAndSeq : prefixes) {
+    if (prefixAndSeq.second != 0 && subscription.contains(prefixAndSeq.first)) {
+      subscribed += prefixAndSeq.first + " " + std::to_string(prefixAndSeq.second) + "\n";
+    }
+  }
+  return subscribed;
+}
+
+void
+appendSubscribeAllToName(ndn::Name& name)
+{
+  const uint8_t marker = MARKER_SUBSCRIBE_ALL;
+  name.append(&marker, 1);
+}
+
+bool
+isSubscribeAllComponent(const ndn::name::Component& component)
+{
+  return component.value_size() == 1 && component.value()[0] == MARKER_SUBSCRIBE_ALL;
+}
+
+void
+appendSubtreesToName(ndn::Name& name, const std::set<std::string>& subtrees)
+{
+  std::vector<uint8_t> buffer;
+  buffer.push_back(MARKER_SUBTREE);
+  for (const std::string& subtree : subtrees) {
+    buffer.push_back(static_cast<uint8_t>(subtree.size() >> 8));
+    buffer.push_back(static_cast<uint8_t>(subtree.size()));
+    buffer.insert(buffer.end(), subtree.begin(), subtree.end());
+  }
+  name.append(buffer.data(), buffer.size());
+}
+
+static bool
+isSubtreeComponent(const ndn::name::Component& component)
+{
+  return component.value_size() >= 1 && component.value()[0] == MARKER_SUBTREE;
+}
+
+static bool
+decodeSubtrees(const ndn::name::Component& component, NameTrie& subtrees)
+{
+  const uint8_t* it = component.value() + 1;
+  const uint8_t* end = component.value() + component.value_size();
+  while (it != end) {
+    if (end - it < 2) {
+      return false;
+    }
+    size_t size = (size_t(it[0]) << 8) | it[1];
+    it += 2;
+    if (static_cast<size_t>(end - it) < size) {
+      return false;
+    }
+    subtrees.insert(std::string(reinterpret_cast<const char*>(it), size));
+    it += size;
+  }
+  return true;
+}
+
+/**
+ * @brief Take the IBF components, and the subtrees and digest before the
+ *        @p nSubscription subscription list components
+ */
+static bool
+parseIBLTSubtreesAndDigest(const ndn::Name& name, size_t nSubscription,
+                           PartialSyncInterest& interest)
+{
+  interest.ibltHeader = &name.get(-2);
+  interest.ibltTable = &name.get(-1);
+
+  size_t index = nSubscription + 3;
+  interest.subtrees = NameTrie();
+  if (name.size() >= index && isSubtreeComponent(name.get(-static_cast<ssize_t>(index)))) {
+    if (!decodeSubtrees(name.get(-static_cast<ssize_t>(index)), interest.subtrees)) {
+      return false;
+    }
+    ++index;
+  }
+
+  interest.hasDigest = name.size() >= index &&
+                       IBLT::isDigestComponent(name.get(-static_cast<ssize_t>(index)));
+  interest.digest = interest.hasDigest ?
+                    IBLT::getDigestFromComponent(name.get(-static_cast<ssize_t>(index))) : 0;
+  return true;
+}
+
+bool
+parsePartialSyncInterest(const ndn::Name& name, PartialSyncInterest& interest)
+{
+  // A one-byte Bloom filter could hold the marker byte too, it is told
+  // apart by the size component of 1 just before it
+  if (name.size() >= 3 && isSubscribeAllComponent(name.get(-3)) &&
+      !(name.size() >= 4 && name.get(-4).isNumber() && name.get(-4).toNumber() == 1)) {
+    interest.isSubscribeAll = true;
+    interest.isBloomFilterEmpty = true;
+    interest.bloomTable = nullptr;
+    interest.bloomTableSize = 0;
+    return parseIBLTSubtreesAndDigest(name, 1, interest);
+  }
+  interest.isSubscribeAll = false;
+
+  if (name.size() < 6) {
+    return false;
+  }
+
+  const ndn::name::Component& count = name.get(-6);
+  const ndn::name::Component& falsePositive = name.get(-5);
+  const ndn::name::Component& bloomSize = name.get(-4);
+  const ndn::name::Component& bloomTable = name.get(-3);
+  if (!count.isNumber() || !falsePositive.isNumber() || !bloomSize.isNumber()) {
+    return false;
+  }
+
+  bloom_parameters& opt = interest.bloomParameters;
+  opt.projected_element_count = count.toNumber();
+  if (!decode_false_positive(falsePositive.toNumber(), opt)) {
+    return false;
+  }
+  // No elements or a rate of 0 or 1 give no table to read, or one smaller
+  // than the filter indexes into
+  if (opt.projected_element_count == 0 || !(opt.false_positive_probability > 0.0) ||
+      opt.false_positive_probability >= 1.0) {
+    return false;
+  }
+  opt.compute_optimal_parameters();
+  std::size_t tableSize = opt.optimal_parameters.table_size / bits_per_char;
+  if (bloomSize.toNumber() != tableSize || tableSize == 0 || tableSize > MAX_BLOOM_TABLE_SIZE) {
+    return false;
+  }
+
+  // the size component is that of the raw table, consumers only send the
+  // compressed one when it is smaller
+  if (bloomTable.value_size() == tableSize) {
+    interest.bloomTable = bloomTable.value();
+  }
+  else if (bloomTable.value_size() < tableSize) {
+    interest.bloomBuffer.resize(tableSize);
+    if (!decompress_bloom_table(bloomTable.value(), bloomTable.value_size(),
+                                interest.bloomBuffer.data(), tableSize)) {
+      return false;
+    }
+    interest.bloomTable = interest.bloomBuffer.data();
+  }
+  else {
+    return false;
+  }
+  interest.bloomTableSize = tableSize;
+  interest.isBloomFilterEmpty = simd::isZero(interest.bloomTable, tableSize);
+  return parseIBLTSubtreesAndDigest(name, 4, interest);
+}
+
+} // namespace psync
@@ -0,0 +1,186 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2018,  The University of Memphis
+ *
+ * This file is part of NLSR (Named-data Link State Routing).
+ * See AUTHORS.md for complete list of NLSR authors and contributors.
+ *
+ * NLSR is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NLSR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NLSR, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef PSYNC_SYNC_INTEREST_HPP
+#define PSYNC_SYNC_INTEREST_HPP
+
+#include "bloom-filter.hpp"
+#include "name-trie.hpp"
+
+#include <ndn-cxx/name.hpp>
+
+#include <inttypes.h>
+#include <cstddef>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace psync {
+
+/**
+ * @brief Largest Bloom filter table, in bytes, a partial sync interest may describe
+ *
+ * The size comes from the consumer's element count and false positive rate,
+ * and a compressed table of a few bytes can stand for it, so larger ones are
+ * refused before anything is allocated. That is over 36,000 prefixes at a
+ * false positive rate of 0.001.
+ */
+static const std::size_t MAX_BLOOM_TABLE_SIZE = 64 * 1024;
+
+/**
+ * @brief What the consumer of a partial sync interest subscribed to: exact
+ *        prefixes in a Bloom filter, whole subtrees, or everything
+ */
+struct Subscription
+{
+  Subscription()
+    : isSubscribeAll(false)
+    , isBloomFilterEmpty(true)
+  {
+  }
+
+  bool
+  contains(const std::string& prefix)
+  {
+    return isSubscribeAll || (!subtrees.empty() && subtrees.hasPrefixOf(prefix)) ||
+           (!isBloomFilterEmpty && bf.contains(prefix));
+  }
+
+  bool isSubscribeAll;
+  // no prefix in bf, which is then never looked at
+  bool isBloomFilterEmpty;
+  bloom_filter bf;
+  NameTrie subtrees;
+};
+
+/**
+ * @brief The trailing components of a partial sync interest,
+ *        /<prefix>/sync/[<digest>]/[<subtrees>]/<count>/<false positive>/<bf size>/<bf>/<IBF header>/<IBF>
+ *        or, from a consumer subscribed to every prefix,
+ *        /<prefix>/sync/[<digest>]/<subscribe all>/<IBF header>/<IBF>
+ *
+ * Only points into the name it was parsed from, which must outlive it: the
+ * Bloom filter and IBF bytes are not copied. A compressed Bloom filter (see
+ * compress_bloom_table) is decoded into bloomBuffer instead.
+ */
+struct PartialSyncInterest
+{
+  // MARKER_SUBSCRIBE_ALL in place of the Bloom filter, which is then empty
+  bool isSubscribeAll;
+  // no bit set in the Bloom filter
+  bool isBloomFilterEmpty;
+  // from the MARKER_SUBTREE component, see appendSubtreesToName
+  NameTrie subtrees;
+  // with optimal_parameters computed
+  bloom_parameters bloomParameters;
+  const uint8_t* bloomTable;
+  std::size_t bloomTableSize;
+  std::vector<uint8_t> bloomBuffer;
+  const ndn::name::Component* ibltHeader;
+  const ndn::name::Component* ibltTable;
+  // digest of the producer IBF the consumer holds, see BasicIBLT::appendDigestToName
+  bool hasDigest;
+  uint32_t digest;
+
+  /**
+   * @brief Read-only Bloom filter over bloomTable, an empty one if isSubscribeAll
+   */
+  bloom_filter
+  getBloomFilter() const
+  {
+    if (isSubscribeAll) {
+      return bloom_filter();
+    }
+    return bloom_filter(bloomParameters, bloomTable, bloomTableSize);
+  }
+
+  /**
+   * @brief Everything the consumer subscribed to, owning its Bloom filter bytes
+   *
+   * It outlives the name and this struct, pending entries keep it until the
+   * interest expires. An empty Bloom filter is never looked at and not copied.
+   */
+  Subscription
+  getSubscription() const
+  {
+    Subscription subscription;
+    subscription.isSubscribeAll = isSubscribeAll;
+    subscription.isBloomFilterEmpty = isSubscribeAll || isBloomFilterEmpty;
+    if (!subscription.isBloomFilterEmpty) {
+      // copied, not moved: a moved filter would still point into the name
+      // or bloomBuffer
+      const bloom_filter view = getBloomFilter();
+      subscription.bf = view;
+    }
+    subscription.subtrees = subtrees;
+    return subscription;
+  }
+};
+
+/**
+ * @brief Sync reply content listing every prefix in @p prefixes with a
+ *        non-zero sequence number
+ *
+ * The producers keep it in @p content between calls: it is only rebuilt when
+ * @p isCurrent is false, which they set whenever a sequence number changes.
+ */
+const std::string&
+getFullStateContent(const std::map<std::string, uint32_t>& prefixes,
+                    std::string& content, bool& isCurrent);
+
+/**
+ * @brief Same as above, restricted to the prefixes in @p subscription
+ *
+ * A consumer subscribed to every prefix gets the shared @p content.
+ */
+std::string
+getFullStateContent(const std::map<std::string, uint32_t>& prefixes,
+                    std::string& content, bool& isCurrent, Subscription& subscription);
+
+/**
+ * @brief Append the MARKER_SUBSCRIBE_ALL component sent in place of a Bloom filter
+ */
+void
+appendSubscribeAllToName(ndn::Name& name);
+
+bool
+isSubscribeAllComponent(const ndn::name::Component& component);
+
+/**
+ * @brief Append the MARKER_SUBTREE component listing @p subtrees, each as a
+ *        2-byte big-endian length followed by the prefix
+ */
+void
+appendSubtreesToName(ndn::Name& name, const std::set<std::string>& subtrees);
+
+/**
+ * @brief Parse the trailing components of a partial sync interest
+ *
+ * @return false if they are missing, of an unknown Bloom filter type, with
+ *         no elements or a false positive rate outside (0, 1), or the
+ *         Bloom filter does not have the size its parameters give, raw or
+ *         once decompressed, or that size is over MAX_BLOOM_TABLE_SIZE
+ */
+bool
+parsePartialSyncInterest(const ndn::Name& name, PartialSyncInterest& interest);
+
+} // namespace psync
+
+#endif // PSYNC_SYNC_INTEREST_HPP
@@ -30,6 +30,12 @@ ROTL32 ( uint32_t x, int8_t r )
 
 uint32_t
 MurmurHash3(uint32_t nHashSeed, const std::vector<unsigned char>& vDataToHash)
+{
+  return MurmurHash3(nHashSeed, vDataToHash.data(), vDataToHash.size());
+}
+
+uint32_t
+MurmurHash3(uint32_t nHashSeed, const uint8_t* data, size_t size)
 {
   // The following is MurmurHash3 (x86_32),
   // see http://code.google.com/p/smhasher/source/browse/trunk/MurmurHash3.cpp
@@ -37,11 +43,11 @@ MurmurHash3(uint32_t nHashSeed, const std::vector<unsigned char>& vDataToHash)
   const uint32_t c1 = 0xcc9e2d51;
   const uint32_t c2 = 0x1b873593;
 
-  const size_t nblocks = vDataToHash.size() / 4;
+  const size_t nblocks = size / 4;
 
   //----------
   // body
-  const uint32_t * blocks = (const uint32_t *)(&vDataToHash[0] + nblocks*4);
+  const uint32_t * blocks = (const uint32_t *)(data + nblocks*4);
 
   for (size_t i = -nblocks; i; i++) {
     uint32_t k1 = blocks[i];
@@ -57,13 +63,13 @@ MurmurHash3(uint32_t nHashSeed, const std::vector<unsigned char>& vDataToHash)
 
   //----------
   // tail
-  const uint8_t * tail = (const uint8_t*)(&vDataToHash[0] + nblocks*4);
+  const uint8_t * tail = (const uint8_t*)(data + nblocks*4);
 
   uint32_t k1 = 0;
 
   // gcc gives "warning: this statement may fall through"
   // Need either fall through or break here
-  switch (vDataToHash.size() & 3) {
+  switch (size & 3) {
     case 3: k1 ^= tail[2] << 16;
     [[fallthrough]];
     case 2: k1 ^= tail[1] << 8;
@@ -74,7 +80,7 @@ MurmurHash3(uint32_t nHashSeed, const std::vector<unsigned char>& vDataToHash)
 
   //----------
   // finalization
-  h1 ^= vDataToHash.size();
+  h1 ^= size;
   h1 ^= h1 >> 16;
   h1 *= 0x85ebca6b;
   h1 ^= h1 >> 13;
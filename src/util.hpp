@@ -32,6 +32,112 @@ namespace psync {
 uint32_t
 MurmurHash3(uint32_t nHashSeed, const std::vector<unsigned char>& vDataToHash);
 
+/**
+ * @brief Same as above over the @p size bytes at @p data, e.g. a string
+ *        without copying it into a vector first
+ */
+uint32_t
+MurmurHash3(uint32_t nHashSeed, const uint8_t* data, size_t size);
+
+/**
+ * @brief Body round of MurmurHash3 (x86_32) for a single 4-byte block
+ *
+ * The block mix does not depend on the seed, so hashing one key under several
+ * seeds can share it and only repeat the seeded part.
+ */
+inline uint32_t
+MurmurHash3Mix(uint32_t block)
+{
+  uint32_t k1 = block * 0xcc9e2d51;
+  k1 = (k1 << 15) | (k1 >> 17);
+  return k1 * 0x1b873593;
+}
+
+/**
+ * @brief Fold a block mixed with MurmurHash3Mix into the running hash @p h1
+ */
+inline uint32_t
+MurmurHash3Round(uint32_t h1, uint32_t mixedBlock)
+{
+  h1 ^= mixedBlock;
+  h1 = (h1 << 13) | (h1 >> 19);
+  return h1*5+0xe6546b64;
+}
+
+/**
+ * @brief MurmurHash3 (x86_32) finalizer for an input of @p length bytes
+ */
+inline uint32_t
+MurmurHash3Fmix(uint32_t h1, uint32_t length)
+{
+  h1 ^= length;
+  h1 ^= h1 >> 16;
+  h1 *= 0x85ebca6b;
+  h1 ^= h1 >> 13;
+  h1 *= 0xc2b2ae35;
+  h1 ^= h1 >> 16;
+
+  return h1;
+}
+
+/**
+ * @brief Seeded part of MurmurHash3 (x86_32) for a 4-byte input
+ *        whose block was mixed with MurmurHash3Mix
+ */
+inline uint32_t
+MurmurHash3Finish(uint32_t nHashSeed, uint32_t mixedKey)
+{
+  return MurmurHash3Fmix(MurmurHash3Round(nHashSeed, mixedKey), 4);
+}
+
+/**
+ * @brief MurmurHash3 of the 4-byte little-endian encoding of @p key
+ *
+ * Returns the same value as the vector overload on those four bytes
+ * without building a vector.
+ */
+inline uint32_t
+MurmurHash3(uint32_t nHashSeed, uint32_t key)
+{
+  return MurmurHash3Finish(nHashSeed, MurmurHash3Mix(key));
+}
+
+/**
+ * @brief MurmurHash3 of the 8-byte little-endian encoding of @p key
+ */
+inline uint32_t
+MurmurHash3(uint32_t nHashSeed, uint64_t key)
+{
+  uint32_t h1 = MurmurHash3Round(nHashSeed, MurmurHash3Mix(static_cast<uint32_t>(key)));
+  h1 = MurmurHash3Round(h1, MurmurHash3Mix(static_cast<uint32_t>(key >> 32)));
+  return MurmurHash3Fmix(h1, 8);
+}
+
+/**
+ * @brief First value byte of the marker components in sync names
+ *
+ * MARKER_ESTIMATOR, MARKER_RATELESS and MARKER_DIGEST tag optional components a
+ * sync name carries between the sync prefix and the trailing IBLT. The IBLT is always
+ * parsed from the end of the name, so peers that do not know a marker simply
+ * never look at its component.
+ *
+ * MARKER_IBLT_FORMAT starts the header of an IBLT in a format other than the
+ * plain one, see IBLTWireFormat.
+ *
+ * MARKER_SUBSCRIBE_ALL stands in a partial sync interest for the subscription
+ * list components of a consumer that wants every prefix, and MARKER_SUBTREE
+ * starts the optional component listing the subtrees it wants, see
+ * PartialSyncInterest.
+ */
+enum NameMarker : uint8_t {
+  MARKER_ESTIMATOR = 0xE0,
+  MARKER_RATELESS = 0xE1,
+  MARKER_IBLT_FORMAT = 0xE2,
+  MARKER_DIGEST = 0xE3,
+  MARKER_SUBSCRIBE_ALL = 0xE4,
+  MARKER_SUBTREE = 0xE5
+};
+
 std::vector<unsigned char>
 ParseHex(const std::string& str);
 
@@ -0,0 +1,207 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2018,  The University of Memphis
+ *
+ * This file is part of NLSR (Named-data Link State Routing).
+ * See AUTHORS.md for complete list of NLSR authors and contributors.
+ *
+ * NLSR is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NLSR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NLSR, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include "bloom-filter.hpp"
+#include "util.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+namespace psync {
+
+static bloom_filter
+makeFilter(unsigned int count, double falsePositive, bloom_filter_type type)
+{
+  bloom_parameters opt;
+  opt.projected_element_count = count;
+  opt.false_positive_probability = falsePositive;
+  opt.type = type;
+  opt.compute_optimal_parameters();
+  return bloom_filter(opt);
+}
+
+BOOST_AUTO_TEST_SUITE(TestBloomFilter)
+
+BOOST_AUTO_TEST_CASE(Basic)
+{
+  for (bloom_filter_type type : {bloom_filter_salted, bloom_filter_blocked,
+                                 bloom_filter_double_hashing}) {
+    bloom_filter bf = makeFilter(100, 0.01, type);
+    for (int i = 0; i < 100; i++) {
+      bf.insert("/test/memphis/" + std::to_string(i));
+    }
+    for (int i = 0; i < 100; i++) {
+      BOOST_CHECK(bf.contains("/test/memphis/" + std::to_string(i)));
+    }
+
+    int numFalsePositives = 0;
+    for (int i = 0; i < 10000; i++) {
+      numFalsePositives += bf.contains("/test/csu/" + std::to_string(i));
+    }
+    // 1% requested, a blocked filter of the same size does somewhat worse
+    BOOST_CHECK_LT(numFalsePositives, 300);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Blocked)
+{
+  bloom_filter bf = makeFilter(100, 0.01, bloom_filter_blocked);
+  BOOST_CHECK_EQUAL(bf.getTableSize() % bloom_block_size, 0);
+  BOOST_CHECK_GE(bf.getTableSize(), makeFilter(100, 0.01, bloom_filter_salted).getTableSize());
+
+  // all the bits of a key are in one block
+  bf.insert("/test/memphis/1");
+  size_t numBlocks = 0;
+  std::vector<uint8_t> table = bf.table();
+  for (size_t i = 0; i < table.size(); i += bloom_block_size) {
+    bool isUsed = false;
+    for (size_t j = i; j < i + bloom_block_size; j++) {
+      isUsed = isUsed || table[j] != 0;
+    }
+    numBlocks += isUsed;
+  }
+  BOOST_CHECK_EQUAL(numBlocks, 1);
+
+  // the table read back from an interest holds the same keys
+  bloom_filter received = makeFilter(100, 0.01, bloom_filter_blocked);
+  BOOST_CHECK(!received.contains("/test/memphis/1"));
+  received.setTable(table);
+  BOOST_CHECK(received.contains("/test/memphis/1"));
+}
+
+BOOST_AUTO_TEST_CASE(Counting)
+{
+  for (bloom_filter_type type : {bloom_filter_salted, bloom_filter_blocked,
+                                 bloom_filter_double_hashing}) {
+    bloom_parameters opt;
+    opt.projected_element_count = 100;
+    opt.false_positive_probability = 0.01;
+    opt.type = type;
+    opt.compute_optimal_parameters();
+    counting_bloom_filter cbf(opt);
+    bloom_filter bf(opt);
+
+    for (int i = 0; i < 100; i++) {
+      cbf.insert("/test/memphis/" + std::to_string(i));
+    }
+    for (int i = 0; i < 100; i += 2) {
+      BOOST_CHECK(cbf.remove("/test/memphis/" + std::to_string(i)));
+    }
+    for (int i = 1; i < 100; i += 2) {
+      BOOST_CHECK(cbf.contains("/test/memphis/" + std::to_string(i)));
+      bf.insert("/test/memphis/" + std::to_string(i));
+    }
+
+    // on the wire it is the plain filter of the keys left
+    BOOST_CHECK(cbf.table() == bf.table());
+
+    for (int i = 1; i < 100; i += 2) {
+      cbf.remove("/test/memphis/" + std::to_string(i));
+    }
+    BOOST_CHECK(cbf.table() == std::vector<uint8_t>(cbf.getTableSize(), 0));
+    BOOST_CHECK(!cbf.remove("/test/memphis/1"));
+    BOOST_CHECK_EQUAL(cbf.element_count(), 0);
+
+    // used as a plain filter, it still counts
+    bloom_filter& plain = cbf;
+    plain.insert("/test/memphis/1");
+    BOOST_CHECK_EQUAL(cbf.element_count(), 1);
+    BOOST_CHECK(cbf.remove("/test/memphis/1"));
+    BOOST_CHECK_EQUAL(cbf.element_count(), 0);
+    BOOST_CHECK(cbf.table() == std::vector<uint8_t>(cbf.getTableSize(), 0));
+
+    plain.insert("/test/memphis/2");
+    plain.clear();
+    BOOST_CHECK(!cbf.remove("/test/memphis/2"));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(CompressedTable)
+{
+  for (int numKeys : {0, 1, 5, 100}) {
+    bloom_filter bf = makeFilter(100, 0.01, bloom_filter_salted);
+    for (int i = 0; i < numKeys; i++) {
+      bf.insert("/test/memphis/" + std::to_string(i));
+    }
+    std::vector<uint8_t> table = bf.table();
+
+    std::vector<uint8_t> compressed;
+    compress_bloom_table(table.data(), table.size(), compressed);
+    if (numKeys <= 5) {
+      BOOST_CHECK_LT(compressed.size(), table.size() / 4);
+    }
+
+    std::vector<uint8_t> decompressed(table.size(), 0xFF);
+    BOOST_CHECK(decompress_bloom_table(compressed.data(), compressed.size(),
+                                       decompressed.data(), decompressed.size()));
+    BOOST_CHECK(decompressed == table);
+
+    // into a table too small for the last bit set
+    if (numKeys > 0) {
+      BOOST_CHECK(!decompress_bloom_table(compressed.data(), compressed.size(),
+                                          decompressed.data(), 1));
+    }
+  }
+
+  std::vector<uint8_t> table(8, 0);
+  std::vector<uint8_t> malformed = {40, 0x00};
+  BOOST_CHECK(!decompress_bloom_table(malformed.data(), malformed.size(), table.data(), 8));
+  malformed = {0, 0xFF, 0xFF};
+  BOOST_CHECK(!decompress_bloom_table(malformed.data(), malformed.size(), table.data(), 8));
+}
+
+BOOST_AUTO_TEST_CASE(SaltedHashesUnchanged)
+{
+  // Salted filters hash the key without copying it, to the same bits as before
+  std::string key = "/test/memphis/1";
+  BOOST_CHECK_EQUAL(MurmurHash3(0xAAAAAAAA, reinterpret_cast<const uint8_t*>(key.data()),
+                                key.size()),
+                    MurmurHash3(0xAAAAAAAA, ParseHex(key)));
+}
+
+BOOST_AUTO_TEST_CASE(FalsePositiveComponent)
+{
+  // the value sent by consumers from before the type was added
+  bloom_parameters opt;
+  BOOST_CHECK(decode_false_positive(1, opt));
+  BOOST_CHECK_EQUAL(opt.type, bloom_filter_salted);
+  BOOST_CHECK_CLOSE(opt.false_positive_probability, 0.001, 1e-6);
+
+  BOOST_CHECK_EQUAL(encode_false_positive(0.001, bloom_filter_salted), 1);
+  BOOST_CHECK(decode_false_positive(encode_false_positive(0.01, bloom_filter_double_hashing), opt));
+  BOOST_CHECK_EQUAL(opt.type, bloom_filter_double_hashing);
+  BOOST_CHECK_CLOSE(opt.false_positive_probability, 0.01, 1e-6);
+
+  BOOST_CHECK(!decode_false_positive(encode_false_positive(0.01, bloom_filter_salted) + (7 << 16),
+                                     opt));
+
+  // rates below a thousandth take an exponent, and come back exactly
+  for (double falsePositive : {0.0001, 0.00005, 0.0015, 0.000001}) {
+    uint64_t value = encode_false_positive(falsePositive, bloom_filter_cuckoo);
+    BOOST_CHECK_GT(value >> 24, 0);
+    BOOST_CHECK(decode_false_positive(value, opt));
+    BOOST_CHECK_EQUAL(opt.type, bloom_filter_cuckoo);
+    BOOST_CHECK_EQUAL(opt.false_positive_probability, falsePositive);
+  }
+  BOOST_CHECK_EQUAL(encode_false_positive(0.02, bloom_filter_salted) >> 24, 0);
+  BOOST_CHECK(!decode_false_positive(uint64_t(10) << 24, opt));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace psync
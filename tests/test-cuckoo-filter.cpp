@@ -0,0 +1,134 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2018,  The University of Memphis
+ *
+ * This file is part of NLSR (Named-data Link State Routing).
+ * See AUTHORS.md for complete list of NLSR authors and contributors.
+ *
+ * NLSR is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NLSR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NLSR, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include "cuckoo-filter.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+namespace psync {
+
+static bloom_parameters
+makeParameters(unsigned int count, double falsePositive, bloom_filter_type type)
+{
+  bloom_parameters opt;
+  opt.projected_element_count = count;
+  opt.false_positive_probability = falsePositive;
+  opt.type = type;
+  opt.compute_optimal_parameters();
+  return opt;
+}
+
+BOOST_AUTO_TEST_SUITE(TestCuckooFilter)
+
+BOOST_AUTO_TEST_CASE(Basic)
+{
+  bloom_parameters opt = makeParameters(100, 0.001, bloom_filter_cuckoo);
+  // ceil(log2(2 * 4 / 0.001))
+  BOOST_CHECK_EQUAL(opt.optimal_parameters.number_of_hashes, 13);
+
+  cuckoo_filter cf(opt);
+  for (int i = 0; i < 100; i++) {
+    BOOST_CHECK(cf.insert("/test/memphis/" + std::to_string(i)));
+  }
+  for (int i = 0; i < 100; i++) {
+    BOOST_CHECK(cf.contains("/test/memphis/" + std::to_string(i)));
+  }
+
+  int numFalsePositives = 0;
+  for (int i = 0; i < 100000; i++) {
+    numFalsePositives += cf.contains("/test/csu/" + std::to_string(i));
+  }
+  BOOST_CHECK_LT(numFalsePositives, 200);
+
+  for (int i = 0; i < 100; i += 2) {
+    BOOST_CHECK(cf.remove("/test/memphis/" + std::to_string(i)));
+  }
+  for (int i = 1; i < 100; i += 2) {
+    BOOST_CHECK(cf.contains("/test/memphis/" + std::to_string(i)));
+  }
+  for (int i = 1; i < 100; i += 2) {
+    BOOST_CHECK(cf.remove("/test/memphis/" + std::to_string(i)));
+  }
+  BOOST_CHECK(cf.table() == std::vector<uint8_t>(cf.getTableSize(), 0));
+}
+
+BOOST_AUTO_TEST_CASE(Full)
+{
+  cuckoo_filter cf(makeParameters(100, 0.01, bloom_filter_cuckoo));
+  int numInserted = 0;
+  std::vector<uint8_t> table;
+  while (true) {
+    table = cf.table();
+    if (!cf.insert("/test/memphis/" + std::to_string(numInserted))) {
+      break;
+    }
+    numInserted++;
+  }
+  BOOST_CHECK_GE(numInserted, 100);
+
+  // a failed insert moves nothing
+  BOOST_CHECK(cf.table() == table);
+  for (int i = 0; i < numInserted; i++) {
+    BOOST_CHECK(cf.contains("/test/memphis/" + std::to_string(i)));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ReadAsBloomFilter)
+{
+  bloom_parameters opt = makeParameters(50, 0.001, bloom_filter_cuckoo);
+  cuckoo_filter cf(opt);
+  for (int i = 0; i < 50; i++) {
+    cf.insert("/test/memphis/" + std::to_string(i));
+  }
+
+  // what a producer does with the table from a sync interest
+  bloom_filter bf(opt, cf.table().data(), cf.getTableSize());
+  BOOST_CHECK_EQUAL(bf.getTableSize(), cf.getTableSize());
+  for (int i = 0; i < 1000; i++) {
+    std::string key = (i < 50 ? "/test/memphis/" : "/test/csu/") + std::to_string(i);
+    BOOST_CHECK_EQUAL(bf.contains(key), cf.contains(key));
+  }
+
+  BOOST_CHECK(decode_false_positive(encode_false_positive(0.001, bloom_filter_cuckoo), opt));
+  BOOST_CHECK_EQUAL(opt.type, bloom_filter_cuckoo);
+}
+
+BOOST_AUTO_TEST_CASE(SmallerThanBloomFilter)
+{
+  // at rates the false positive component carries with an exponent
+  for (double falsePositive : {0.00001, 0.000001}) {
+    bloom_parameters opt;
+    BOOST_REQUIRE(decode_false_positive(encode_false_positive(falsePositive, bloom_filter_cuckoo),
+                                        opt));
+    opt.projected_element_count = 1000;
+    opt.compute_optimal_parameters();
+    bloom_parameters bloom = makeParameters(1000, opt.false_positive_probability,
+                                            bloom_filter_salted);
+    BOOST_CHECK_LT(opt.optimal_parameters.table_size, bloom.optimal_parameters.table_size);
+
+    cuckoo_filter cf(opt);
+    for (int i = 0; i < 1000; i++) {
+      BOOST_CHECK(cf.insert("/test/memphis/" + std::to_string(i)));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace psync
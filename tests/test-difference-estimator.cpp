@@ -0,0 +1,120 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2018,  The University of Memphis
+ *
+ * This file is part of NLSR (Named-data Link State Routing).
+ * See AUTHORS.md for complete list of NLSR authors and contributors.
+ *
+ * NLSR is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NLSR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NLSR, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include "difference-estimator.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+
+#include <boost/test/unit_test.hpp>
+#include <ndn-cxx/name.hpp>
+
+namespace psync {
+
+using namespace ndn;
+
+static uint32_t
+getHash(const std::string& prefix, int seq)
+{
+  return MurmurHash3(11, ParseHex(prefix + "/" + std::to_string(seq)));
+}
+
+BOOST_AUTO_TEST_SUITE(TestDifferenceEstimator)
+
+BOOST_AUTO_TEST_CASE(ExactForSmallSets)
+{
+  DifferenceEstimator estimator1, estimator2;
+
+  for (int i = 1; i <= 10; i++) {
+    estimator1.insert(getHash("/test/memphis", i));
+    estimator2.insert(getHash("/test/memphis", i));
+  }
+  estimator2.insert(getHash("/test/delft", 1));
+  estimator2.insert(getHash("/test/delft", 2));
+  estimator1.insert(getHash("/test/arizona", 1));
+
+  Name name("sync");
+  estimator2.appendToName(name);
+  BOOST_CHECK(DifferenceEstimator::isEstimatorComponent(name.get(-1)));
+  BOOST_CHECK_EQUAL(estimator1.estimateDifference(name.get(-1)), 3);
+
+  Name sameName("sync");
+  estimator1.appendToName(sameName);
+  BOOST_CHECK_EQUAL(estimator1.estimateDifference(sameName.get(-1)), 0);
+
+  BOOST_CHECK(!DifferenceEstimator::isEstimatorComponent(name.get(0)));
+  BOOST_CHECK_THROW(estimator1.estimateDifference(name.get(0)), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(LargeDifference)
+{
+  DifferenceEstimator estimator1, estimator2;
+
+  for (int i = 1; i <= 1000; i++) {
+    estimator1.insert(getHash("/test/memphis", i));
+    estimator2.insert(getHash("/test/memphis", i));
+  }
+  for (int i = 1; i <= 1000; i++) {
+    estimator2.insert(getHash("/test/delft", i));
+  }
+
+  Name name("sync");
+  estimator2.appendToName(name);
+  size_t estimate = estimator1.estimateDifference(name.get(-1));
+  // a 32-hash sketch is good to a factor of two, enough to tell a partition
+  BOOST_CHECK_GT(estimate, 500);
+  BOOST_CHECK_LT(estimate, 2000);
+}
+
+BOOST_AUTO_TEST_CASE(EraseAndRebuild)
+{
+  DifferenceEstimator estimator;
+
+  std::vector<uint32_t> hashes;
+  for (int i = 1; i <= 200; i++) {
+    hashes.push_back(getHash("/test/memphis", i));
+    estimator.insert(hashes.back());
+  }
+  BOOST_CHECK(!estimator.needsRebuild());
+
+  std::sort(hashes.begin(), hashes.end());
+  for (size_t i = 0; i < 40; i++) {
+    estimator.erase(hashes[i]);
+  }
+  BOOST_CHECK_EQUAL(estimator.getNumElements(), 160);
+  BOOST_CHECK(estimator.needsRebuild());
+
+  estimator.clear();
+  for (size_t i = 40; i < hashes.size(); i++) {
+    estimator.insert(hashes[i]);
+  }
+  BOOST_CHECK(!estimator.needsRebuild());
+
+  DifferenceEstimator other;
+  for (size_t i = 40; i < hashes.size(); i++) {
+    other.insert(hashes[i]);
+  }
+  Name name("sync");
+  other.appendToName(name);
+  BOOST_CHECK_EQUAL(estimator.estimateDifference(name.get(-1)), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace psync
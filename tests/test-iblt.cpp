@@ -65,11 +65,228 @@ BOOST_AUTO_TEST_CASE(EncodeDecodeTest)
   iblt.appendToName(ibltName);
 
   // May be make this static function?
-  IBLT rcvd = iblt.getIBLTFromName(size,
-                                   ibltName.get(ibltName.size()-2).toNumber(),
+  IBLT rcvd = iblt.getIBLTFromName(ibltName.get(ibltName.size()-2),
                                    ibltName.get(ibltName.size()-1));
 }
 
+BOOST_AUTO_TEST_CASE(EncodeDecodeLargeTable)
+{
+  // Large enough to exercise both the vector kernels and their scalar tails
+  int size = 101;
+
+  IBLT iblt(size);
+  for (int i = 0; i < 40; i++) {
+    std::string prefix = "/test/memphis/" + std::to_string(i);
+    iblt.insert(MurmurHash3(11, ParseHex(prefix)));
+  }
+  std::string prefix = "/test/csu/" + std::to_string(1);
+  iblt.erase(MurmurHash3(11, ParseHex(prefix)));
+
+  Name ibltName("sync");
+  iblt.appendToName(ibltName, IBLT_WIRE_PLAIN);
+
+  const name::Component& table = ibltName.get(ibltName.size()-1);
+  std::vector<HashTableEntry> cells = iblt.getHashTable();
+  BOOST_REQUIRE_EQUAL(table.value_size(), cells.size() * 12);
+
+  // Wire layout is count, keySum, keyCheck per cell, each little-endian
+  for (size_t i = 0; i < cells.size(); i++) {
+    const uint8_t* cell = table.value() + i * 12;
+    uint32_t values[] = {static_cast<uint32_t>(cells[i].count), cells[i].keySum, cells[i].keyCheck};
+    for (size_t j = 0; j < 3; j++) {
+      uint32_t decoded = cell[j*4] | (cell[j*4+1] << 8) | (cell[j*4+2] << 16) |
+                         (static_cast<uint32_t>(cell[j*4+3]) << 24);
+      BOOST_CHECK_EQUAL(decoded, values[j]);
+    }
+  }
+
+  IBLT rcvd = iblt.getIBLTFromName(ibltName.get(ibltName.size()-2),
+                                   ibltName.get(ibltName.size()-1));
+  BOOST_CHECK(rcvd == iblt);
+  BOOST_CHECK((rcvd - iblt).empty());
+  BOOST_CHECK(!(rcvd - IBLT(size)).empty());
+}
+
+BOOST_AUTO_TEST_CASE(EncodeDecodeCompact)
+{
+  int size = 101;
+
+  IBLT empty(size);
+  Name emptyName("sync");
+  empty.appendToName(emptyName);
+  // one bit per cell and nothing else
+  BOOST_CHECK_EQUAL(emptyName.get(-1).value_size(), (empty.getNumEntry() + 7) / 8);
+  BOOST_CHECK(empty.getIBLTFromName(emptyName.get(-2), emptyName.get(-1)) == empty);
+
+  IBLT iblt(size);
+  for (int i = 0; i < 20; i++) {
+    iblt.insert(MurmurHash3(11, ParseHex("/test/memphis/" + std::to_string(i))));
+  }
+
+  Name compactName("sync"), plainName("sync");
+  iblt.appendToName(compactName);
+  iblt.appendToName(plainName, IBLT_WIRE_PLAIN);
+  BOOST_CHECK_LT(compactName.get(-1).value_size(), plainName.get(-1).value_size());
+
+  IBLT fromCompact = iblt.getIBLTFromName(compactName.get(-2), compactName.get(-1));
+  IBLT fromPlain = iblt.getIBLTFromName(plainName.get(-2), plainName.get(-1));
+  BOOST_CHECK(fromCompact == iblt);
+  BOOST_CHECK(fromPlain == iblt);
+
+  // Negative and zero counts with non-empty sums survive the zig-zag varints
+  IBLT other(size);
+  for (int i = 0; i < 10; i++) {
+    other.insert(MurmurHash3(11, ParseHex("/test/csu/" + std::to_string(i))));
+  }
+  IBLT diff = iblt - other;
+  Name diffName("sync");
+  diff.appendToName(diffName);
+  BOOST_CHECK(diff.getIBLTFromName(diffName.get(-2), diffName.get(-1)) == diff);
+
+  // Truncated or padded tables are rejected
+  IBLT::PeelWorkspace workspace;
+  std::set<uint32_t> positive, negative;
+  const name::Component& table = compactName.get(-1);
+  name::Component truncated(table.value(), table.value() + table.value_size() - 1);
+  BOOST_CHECK(!iblt.listDifference(compactName.get(-2), truncated, positive, negative, workspace));
+  std::vector<uint8_t> padded(table.value(), table.value() + table.value_size());
+  padded.push_back(0);
+  BOOST_CHECK(!iblt.listDifference(compactName.get(-2), name::Component(padded.begin(), padded.end()),
+                                   positive, negative, workspace));
+  BOOST_CHECK(iblt.listDifference(compactName.get(-2), table, positive, negative, workspace));
+  BOOST_CHECK(positive.empty() && negative.empty());
+
+  // The cell count in the header is checked against ours and against the
+  // table length before anything is allocated for it
+  size_t numCells = iblt.getCells().size;
+  auto makeHeader = [&compactName] (uint32_t n) {
+    std::vector<uint8_t> header(compactName.get(-2).value(),
+                                compactName.get(-2).value() + compactName.get(-2).value_size());
+    for (size_t b = 0; b < 4; b++) {
+      header[2 + b] = static_cast<uint8_t>(n >> (8 * b));
+    }
+    return name::Component(header.begin(), header.end());
+  };
+  std::vector<uint8_t> emptyTable((2 * numCells + 7) / 8, 0);
+  name::Component twice = makeHeader(2 * numCells);
+  BOOST_CHECK(iblt.canReadFromName(twice, name::Component(emptyTable.begin(), emptyTable.end())));
+  BOOST_CHECK(!iblt.canReadFromName(twice, name::Component(emptyTable.begin(),
+                                                           emptyTable.end() - 1)));
+
+  uint32_t tooMany = (IBLT::MAX_RECEIVED_FOLD * 2) * numCells;
+  emptyTable.assign((tooMany + 7) / 8, 0);
+  name::Component tooManyTable(emptyTable.begin(), emptyTable.end());
+  BOOST_CHECK(!iblt.canReadFromName(makeHeader(tooMany), tooManyTable));
+  BOOST_CHECK(!iblt.listDifference(makeHeader(tooMany), tooManyTable, positive, negative,
+                                   workspace));
+  BOOST_CHECK_THROW(iblt.getIBLTFromName(makeHeader(tooMany), tooManyTable),
+                    std::invalid_argument);
+  // A few bytes cannot claim billions of cells
+  BOOST_CHECK(!iblt.listDifference(makeHeader(numCells << 24), table, positive, negative,
+                                   workspace));
+
+  // The same bound holds for the plain format
+  std::vector<uint8_t> plainTable(IBLT::CELL_SIZE * tooMany, 0);
+  name::Component plain(plainTable.begin(), plainTable.end());
+  BOOST_CHECK(!iblt.canReadFromName(name::Component::fromNumber(plainTable.size()), plain));
+}
+
+BOOST_AUTO_TEST_CASE(EncodeDecodeDelta)
+{
+  int size = 50;
+
+  IBLT base(size);
+  for (int i = 0; i < 20; i++) {
+    base.insert(MurmurHash3(11, ParseHex("/test/memphis/" + std::to_string(i))));
+  }
+  IBLT iblt(base);
+  BOOST_CHECK_EQUAL(iblt.getDigest(), base.getDigest());
+
+  uint32_t hash = MurmurHash3(11, ParseHex("/test/csu/1"));
+  iblt.insert(hash);
+  BOOST_CHECK_NE(iblt.getDigest(), base.getDigest());
+
+  Name deltaName("sync");
+  iblt.appendDeltaToName(deltaName, base);
+  BOOST_CHECK(IBLT::isDeltaHeader(deltaName.get(-2)));
+  BOOST_CHECK(!IBLT::isDeltaHeader(Name("sync").appendNumber(60).get(-1)));
+  BOOST_CHECK_EQUAL(IBLT::getDeltaBase(deltaName.get(-2)), base.getDigest());
+
+  Name compactName("sync");
+  iblt.appendToName(compactName);
+  BOOST_CHECK_LT(deltaName.get(-1).value_size(), compactName.get(-1).value_size());
+
+  IBLT rcvd(base);
+  BOOST_CHECK(rcvd.applyDelta(deltaName.get(-1)));
+  BOOST_CHECK(rcvd == iblt);
+  BOOST_CHECK_EQUAL(rcvd.getDigest(), iblt.getDigest());
+
+  // Equal tables need no cells
+  Name emptyDelta("sync");
+  iblt.appendDeltaToName(emptyDelta, iblt);
+  BOOST_CHECK_EQUAL(emptyDelta.get(-1).value_size(), 0);
+
+  // Deltas cannot be peeled without their base, nor read as a full table
+  IBLT::PeelWorkspace workspace;
+  std::set<uint32_t> positive, negative;
+  BOOST_CHECK(!base.listDifference(deltaName.get(-2), deltaName.get(-1), positive, negative,
+                                   workspace));
+  BOOST_CHECK_THROW(base.getIBLTFromName(deltaName.get(-2), deltaName.get(-1)),
+                    std::invalid_argument);
+
+  // Truncated deltas and cells past the end are rejected
+  const name::Component& table = deltaName.get(-1);
+  IBLT copy(base);
+  BOOST_CHECK(!copy.applyDelta(name::Component(table.value(),
+                                               table.value() + table.value_size() - 1)));
+  std::vector<uint8_t> outOfRange{0xFF, 0x7F};
+  BOOST_CHECK(!copy.applyDelta(name::Component(outOfRange.begin(), outOfRange.end())));
+}
+
+BOOST_AUTO_TEST_CASE(DigestComponent)
+{
+  IBLT iblt(10);
+  iblt.insert(MurmurHash3(11, ParseHex("/test/memphis/1")));
+
+  Name name("sync");
+  IBLT::appendDigestToName(name, iblt.getDigest());
+  iblt.appendToName(name);
+
+  BOOST_CHECK(IBLT::isDigestComponent(name.get(-3)));
+  BOOST_CHECK(!IBLT::isDigestComponent(name.get(-2)));
+  BOOST_CHECK(!IBLT::isDigestComponent(name.get(0)));
+  BOOST_CHECK_EQUAL(IBLT::getDigestFromComponent(name.get(-3)), iblt.getDigest());
+}
+
+BOOST_AUTO_TEST_CASE(CachedEncoding)
+{
+  int size = 10;
+
+  IBLT iblt(size);
+  iblt.insert(MurmurHash3(11, ParseHex("/test/memphis/1")));
+
+  // Repeated encodings are reused until the table changes
+  Name first("sync"), second("sync");
+  iblt.appendToName(first);
+  iblt.appendToName(second);
+  BOOST_CHECK_EQUAL(first, second);
+
+  uint64_t version = iblt.getVersion();
+  iblt.insert(MurmurHash3(11, ParseHex("/test/memphis/2")));
+  BOOST_CHECK_GT(iblt.getVersion(), version);
+
+  Name changed("sync");
+  iblt.appendToName(changed);
+  BOOST_CHECK(changed.get(-1) != first.get(-1));
+  BOOST_CHECK(iblt.getIBLTFromName(changed.get(-2), changed.get(-1)) == iblt);
+
+  // Switching formats re-encodes
+  Name plain("sync");
+  iblt.appendToName(plain, IBLT_WIRE_PLAIN);
+  BOOST_CHECK_EQUAL(plain.get(-1).value_size(), iblt.getNumEntry() * IBLT::CELL_SIZE);
+  BOOST_CHECK(iblt.getIBLTFromName(plain.get(-2), plain.get(-1)) == iblt);
+}
+
 BOOST_AUTO_TEST_CASE(CopyInsertErase)
 {
   int size = 10;
@@ -161,6 +378,353 @@ BOOST_AUTO_TEST_CASE(Difference)
   BOOST_CHECK_EQUAL(negative.size(), 1);
 }
 
+BOOST_AUTO_TEST_CASE(KeyHashMatchesVectorHash)
+{
+  // The IBLT hashes keys without building vectors, cells on the wire
+  // must still match what the vector version of MurmurHash3 produces
+  std::vector<uint32_t> keys = {0, 1, 0xFF, 0x12345678, 0xFFFFFFFF};
+  for (int i = 0; i < 10; i++) {
+    keys.push_back(MurmurHash3(11, ParseHex("/test/memphis/" + std::to_string(i))));
+  }
+
+  for (uint32_t key : keys) {
+    std::vector<unsigned char> bytes = {static_cast<unsigned char>(key & 0xFF),
+                                        static_cast<unsigned char>((key >> 8) & 0xFF),
+                                        static_cast<unsigned char>((key >> 16) & 0xFF),
+                                        static_cast<unsigned char>((key >> 24) & 0xFF)};
+    for (uint32_t seed : {0, 1, 2, 11}) {
+      BOOST_CHECK_EQUAL(MurmurHash3(seed, key), MurmurHash3(seed, bytes));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(PeelWithWorkspace)
+{
+  int size = 40;
+
+  IBLT ownIBF(size);
+  IBLT rcvdIBF(size);
+
+  std::set<uint32_t> inserted;
+  for (int i = 0; i < 15; i++) {
+    std::string prefix = "/test/memphis/" + std::to_string(i);
+    uint32_t hash = MurmurHash3(11, ParseHex(prefix));
+    ownIBF.insert(hash);
+    inserted.insert(hash);
+  }
+
+  IBLT::PeelWorkspace workspace;
+  std::set<uint32_t> positive;
+  std::set<uint32_t> negative;
+
+  IBLT diff = ownIBF - rcvdIBF;
+  BOOST_CHECK_EQUAL(diff.listEntries(positive, negative, workspace), true);
+  BOOST_CHECK(positive == inserted);
+  BOOST_CHECK_EQUAL(negative.size(), 0);
+
+  // Reusing the workspace on a different table gives the same result as a fresh one
+  std::string prefix = "/test/csu/" + std::to_string(1);
+  uint32_t newHash = MurmurHash3(11, ParseHex(prefix));
+  rcvdIBF.insert(newHash);
+
+  diff = ownIBF - rcvdIBF;
+  positive.clear();
+  BOOST_CHECK_EQUAL(diff.listEntries(positive, negative, workspace), true);
+  BOOST_CHECK(positive == inserted);
+  BOOST_CHECK_EQUAL(negative.size(), 1);
+  BOOST_CHECK_EQUAL(*negative.begin(), newHash);
+}
+
+BOOST_AUTO_TEST_CASE(ListDifference)
+{
+  int size = 40;
+
+  IBLT ownIBF(size);
+  IBLT rcvdIBF(size);
+
+  for (int i = 0; i < 10; i++) {
+    uint32_t hash = MurmurHash3(11, ParseHex("/test/memphis/" + std::to_string(i)));
+    ownIBF.insert(hash);
+    rcvdIBF.insert(hash);
+  }
+  // odd count so the vector kernels also run their scalar tail
+  for (int i = 0; i < 7; i++) {
+    ownIBF.insert(MurmurHash3(11, ParseHex("/test/csu/" + std::to_string(i))));
+  }
+  for (int i = 0; i < 4; i++) {
+    rcvdIBF.insert(MurmurHash3(11, ParseHex("/test/delft/" + std::to_string(i))));
+  }
+
+  std::set<uint32_t> expectedPositive, expectedNegative;
+  BOOST_CHECK((ownIBF - rcvdIBF).listEntries(expectedPositive, expectedNegative));
+
+  Name rcvdName("sync");
+  rcvdIBF.appendToName(rcvdName);
+
+  IBLT::PeelWorkspace workspace;
+  std::set<uint32_t> positive, negative;
+  BOOST_CHECK(ownIBF.listDifference(rcvdName.get(-2), rcvdName.get(-1), positive, negative, workspace));
+  BOOST_CHECK(positive == expectedPositive);
+  BOOST_CHECK(negative == expectedNegative);
+
+  Name rcvdPlainName("sync");
+  rcvdIBF.appendToName(rcvdPlainName, IBLT_WIRE_PLAIN);
+  positive.clear();
+  negative.clear();
+  BOOST_CHECK(ownIBF.listDifference(rcvdPlainName.get(-2), rcvdPlainName.get(-1),
+                                    positive, negative, workspace));
+  BOOST_CHECK(positive == expectedPositive);
+  BOOST_CHECK(negative == expectedNegative);
+
+  positive.clear();
+  negative.clear();
+  BOOST_CHECK(ownIBF.listDifference(rcvdIBF, positive, negative, workspace));
+  BOOST_CHECK(positive == expectedPositive);
+  BOOST_CHECK(negative == expectedNegative);
+
+  // A table of a size that does not fold onto ours is rejected instead of misread
+  Name otherName("sync");
+  IBLT(size * 3 / 2).appendToName(otherName);
+  BOOST_CHECK(!ownIBF.listDifference(otherName.get(-2), otherName.get(-1), positive, negative, workspace));
+}
+
+BOOST_AUTO_TEST_CASE(Fold)
+{
+  // 36 and 144 expected entries give partitions of 18 and 72 cells
+  IBLT small(36), large(144);
+  BOOST_CHECK(large.canFoldTo(small.getNumEntry()));
+  BOOST_CHECK(!small.canFoldTo(large.getNumEntry()));
+  BOOST_CHECK(!large.canFoldTo(IBLT(60).getNumEntry()));
+  BOOST_CHECK_THROW(small.fold(large.getNumEntry()), std::invalid_argument);
+
+  std::set<uint32_t> expectedPositive, expectedNegative;
+  for (int i = 0; i < 30; i++) {
+    uint32_t hash = MurmurHash3(11, ParseHex("/test/memphis/" + std::to_string(i)));
+    small.insert(hash);
+    large.insert(hash);
+  }
+  // Folding gives the table the same keys would have built
+  BOOST_CHECK(large.fold(small.getNumEntry()) == small);
+
+  for (int i = 0; i < 5; i++) {
+    uint32_t hash = MurmurHash3(11, ParseHex("/test/csu/" + std::to_string(i)));
+    large.insert(hash);
+    expectedPositive.insert(hash);
+  }
+  for (int i = 0; i < 3; i++) {
+    uint32_t hash = MurmurHash3(11, ParseHex("/test/ucla/" + std::to_string(i)));
+    small.insert(hash);
+    expectedNegative.insert(hash);
+  }
+
+  IBLT::PeelWorkspace workspace;
+  std::set<uint32_t> positive, negative;
+  BOOST_CHECK(large.listDifference(small, positive, negative, workspace));
+  BOOST_CHECK(positive == expectedPositive);
+  BOOST_CHECK(negative == expectedNegative);
+
+  // Either side can receive the other's table in either format
+  for (auto format : {IBLT_WIRE_COMPACT, IBLT_WIRE_PLAIN}) {
+    Name smallName("sync"), largeName("sync");
+    small.appendToName(smallName, format);
+    large.appendToName(largeName, format);
+
+    positive.clear();
+    negative.clear();
+    BOOST_CHECK(large.listDifference(smallName.get(-2), smallName.get(-1), positive, negative,
+                                     workspace));
+    BOOST_CHECK(positive == expectedPositive);
+    BOOST_CHECK(negative == expectedNegative);
+
+    positive.clear();
+    negative.clear();
+    BOOST_CHECK(small.listDifference(largeName.get(-2), largeName.get(-1), positive, negative,
+                                     workspace));
+    BOOST_CHECK(positive == expectedNegative);
+    BOOST_CHECK(negative == expectedPositive);
+
+    IBLT rcvd = small.getIBLTFromName(largeName.get(-2), largeName.get(-1));
+    BOOST_CHECK(rcvd == large);
+  }
+
+  positive.clear();
+  negative.clear();
+  BOOST_CHECK((small - large).listEntries(positive, negative));
+  BOOST_CHECK(positive == expectedNegative);
+  BOOST_CHECK(negative == expectedPositive);
+}
+
+BOOST_AUTO_TEST_CASE(BoundedPeel)
+{
+  int size = 40;
+
+  IBLT ownIBF(size), rcvdIBF(size);
+  for (int i = 0; i < 20; i++) {
+    ownIBF.insert(MurmurHash3(11, ParseHex("/test/memphis/" + std::to_string(i))));
+  }
+  BOOST_CHECK_LE(ownIBF.estimateNumEntries(), 20);
+  BOOST_CHECK_GE(ownIBF.estimateNumEntries(), 1);
+  BOOST_CHECK_EQUAL(rcvdIBF.estimateNumEntries(), 0);
+
+  IBLT::PeelWorkspace workspace;
+  std::set<uint32_t> positive, negative;
+  BOOST_CHECK_EQUAL(ownIBF.listDifference(rcvdIBF, positive, negative, workspace), PEEL_COMPLETE);
+  BOOST_CHECK_EQUAL(positive.size(), 20);
+
+  // Stops once the bound is reached
+  positive.clear();
+  BOOST_CHECK_EQUAL(ownIBF.listDifference(rcvdIBF, positive, negative, workspace, 5),
+                    PEEL_AT_BOUND);
+  BOOST_CHECK_EQUAL(positive.size(), 5);
+
+  // A difference of exactly the bound is still fully decoded
+  positive.clear();
+  BOOST_CHECK_EQUAL(ownIBF.listDifference(rcvdIBF, positive, negative, workspace, 20),
+                    PEEL_COMPLETE);
+  BOOST_CHECK_EQUAL(positive.size(), 20);
+
+  // A table too full to peel still reports a difference above the bound
+  IBLT full(size);
+  for (int i = 0; i < 400; i++) {
+    full.insert(MurmurHash3(11, ParseHex("/test/csu/" + std::to_string(i))));
+  }
+  BOOST_CHECK_GE(full.estimateNumEntries(), size);
+  positive.clear();
+  BOOST_CHECK_EQUAL(full.listEntries(positive, negative, workspace), PEEL_FAILED);
+  positive.clear();
+  // which is not mistaken for a decoded one
+  BOOST_CHECK_EQUAL(full.listEntries(positive, negative, workspace, size), PEEL_AT_BOUND);
+  BOOST_CHECK_LT(positive.size() + negative.size(), size);
+  BOOST_CHECK_EQUAL(full.listDifference(rcvdIBF, positive, negative, workspace, size),
+                    PEEL_AT_BOUND);
+
+  // but not when the bound is above what it shows
+  BOOST_CHECK_EQUAL(full.listDifference(rcvdIBF, positive, negative, workspace, 100000),
+                    PEEL_FAILED);
+}
+
+BOOST_AUTO_TEST_CASE(MoveAndCellView)
+{
+  int size = 40;
+
+  IBLT ownIBF(size);
+  for (int i = 0; i < 10; i++) {
+    ownIBF.insert(MurmurHash3(11, ParseHex("/test/memphis/" + std::to_string(i))));
+  }
+  IBLT copy(ownIBF);
+
+  IBLT moved(std::move(ownIBF));
+  BOOST_CHECK(moved == copy);
+
+  IBLT assigned(size);
+  assigned = std::move(moved);
+  BOOST_CHECK(assigned == copy);
+
+  IBLT::CellView cells = assigned.getCells();
+  std::vector<HashTableEntry> hashTable = assigned.getHashTable();
+  BOOST_REQUIRE_EQUAL(cells.size, hashTable.size());
+  for (size_t i = 0; i < cells.size; i++) {
+    BOOST_CHECK_EQUAL(cells.count[i], hashTable[i].count);
+    BOOST_CHECK_EQUAL(cells.keySum[i], hashTable[i].keySum);
+    BOOST_CHECK_EQUAL(cells.keyCheck[i], hashTable[i].keyCheck);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(FlatAndVisitorResults)
+{
+  int size = 40;
+
+  IBLT ownIBF(size), rcvdIBF(size);
+  for (int i = 0; i < 10; i++) {
+    uint32_t hash = MurmurHash3(11, ParseHex("/test/memphis/" + std::to_string(i)));
+    ownIBF.insert(hash);
+    if (i < 7) {
+      rcvdIBF.insert(hash);
+    }
+  }
+  rcvdIBF.insert(MurmurHash3(11, ParseHex("/test/csu/1")));
+
+  IBLT::PeelWorkspace workspace;
+  std::set<uint32_t> positive, negative;
+  BOOST_REQUIRE(ownIBF.listDifference(rcvdIBF, positive, negative, workspace));
+
+  std::vector<uint32_t> flatPositive, flatNegative;
+  BOOST_CHECK(ownIBF.listDifference(rcvdIBF, flatPositive, flatNegative, workspace));
+  BOOST_CHECK(std::set<uint32_t>(flatPositive.begin(), flatPositive.end()) == positive);
+  BOOST_CHECK(std::set<uint32_t>(flatNegative.begin(), flatNegative.end()) == negative);
+
+  std::set<uint32_t> visitedPositive, visitedNegative;
+  BOOST_CHECK(ownIBF.listDifference(rcvdIBF,
+                                    [&] (uint32_t key, bool isPositive) {
+                                      (isPositive ? visitedPositive : visitedNegative).insert(key);
+                                    },
+                                    workspace));
+  BOOST_CHECK(visitedPositive == positive);
+  BOOST_CHECK(visitedNegative == negative);
+
+  // The flat overload appends, the caller clears between calls
+  flatPositive.clear();
+  flatNegative.clear();
+  BOOST_CHECK((ownIBF - rcvdIBF).listEntries(flatPositive, flatNegative, workspace));
+  BOOST_CHECK_EQUAL(flatPositive.size(), 3);
+  BOOST_CHECK_EQUAL(flatNegative.size(), 1);
+
+  size_t numVisited = 0;
+  BOOST_CHECK((ownIBF - rcvdIBF).listEntries([&] (uint32_t, bool) { numVisited++; },
+                                             workspace, 2));
+  BOOST_CHECK_EQUAL(numVisited, 2);
+}
+
+BOOST_AUTO_TEST_CASE(CustomTraits)
+{
+  // Four hash functions, 64-bit keys and 8-bit counts
+  typedef BasicIBLT<IBLTTraits<4, uint64_t, int8_t>> WideKeyIBLT;
+  int size = 30;
+
+  WideKeyIBLT ownIBF(size);
+  WideKeyIBLT rcvdIBF(size);
+  BOOST_CHECK_EQUAL(ownIBF.getNumEntry() % 4, 0);
+  BOOST_CHECK_EQUAL(WideKeyIBLT::CELL_SIZE, 13);
+
+  std::set<uint64_t> inserted;
+  for (uint64_t i = 0; i < 10; i++) {
+    uint64_t key = (i << 40) | MurmurHash3(11, ParseHex("/test/memphis/" + std::to_string(i)));
+    ownIBF.insert(key);
+    inserted.insert(key);
+  }
+  uint64_t theirs = 0xDEADBEEF00000001ULL;
+  rcvdIBF.insert(theirs);
+
+  Name ibltName("sync");
+  ownIBF.appendToName(ibltName, IBLT_WIRE_PLAIN);
+  BOOST_CHECK_EQUAL(ibltName.get(-1).value_size(), ownIBF.getNumEntry() * WideKeyIBLT::CELL_SIZE);
+
+  WideKeyIBLT decoded = rcvdIBF.getIBLTFromName(ibltName.get(-2),
+                                                ibltName.get(-1));
+  BOOST_CHECK(decoded == ownIBF);
+
+  std::set<uint64_t> positive;
+  std::set<uint64_t> negative;
+  WideKeyIBLT diff = decoded - rcvdIBF;
+  BOOST_CHECK_EQUAL(diff.listEntries(positive, negative), true);
+  BOOST_CHECK(positive == inserted);
+  BOOST_REQUIRE_EQUAL(negative.size(), 1);
+  BOOST_CHECK_EQUAL(*negative.begin(), theirs);
+
+  // The fused path and the compact format handle the narrow layout too
+  Name compactName("sync");
+  ownIBF.appendToName(compactName);
+  BOOST_CHECK(rcvdIBF.getIBLTFromName(compactName.get(-2), compactName.get(-1)) == ownIBF);
+
+  WideKeyIBLT::PeelWorkspace workspace;
+  positive.clear();
+  negative.clear();
+  BOOST_CHECK(rcvdIBF.listDifference(ibltName.get(-2), ibltName.get(-1), positive, negative, workspace));
+  BOOST_CHECK(negative == inserted);
+  BOOST_REQUIRE_EQUAL(positive.size(), 1);
+  BOOST_CHECK_EQUAL(*positive.begin(), theirs);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } // namespace psync
\ No newline at end of file
@@ -0,0 +1,66 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2018,  The University of Memphis
+ *
+ * This file is part of NLSR (Named-data Link State Routing).
+ * See AUTHORS.md for complete list of NLSR authors and contributors.
+ *
+ * NLSR is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NLSR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NLSR, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include "name-trie.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+namespace psync {
+
+BOOST_AUTO_TEST_SUITE(TestNameTrie)
+
+BOOST_AUTO_TEST_CASE(HasPrefixOf)
+{
+  NameTrie trie;
+  BOOST_CHECK(trie.empty());
+  BOOST_CHECK(!trie.hasPrefixOf("/plant/line3"));
+
+  trie.insert("/plant/line3");
+  trie.insert("/plant/line3/");
+  trie.insert("/office/floor1/room2");
+  BOOST_CHECK_EQUAL(trie.size(), 2);
+
+  BOOST_CHECK(trie.hasPrefixOf("/plant/line3"));
+  BOOST_CHECK(trie.hasPrefixOf("/plant/line3/pump2"));
+  BOOST_CHECK(trie.hasPrefixOf("/plant/line3/pump2/temperature"));
+  BOOST_CHECK(!trie.hasPrefixOf("/plant/line30"));
+  BOOST_CHECK(!trie.hasPrefixOf("/plant"));
+  BOOST_CHECK(!trie.hasPrefixOf("/plant/line4/pump2"));
+  BOOST_CHECK(!trie.hasPrefixOf("/office/floor1"));
+  BOOST_CHECK(trie.hasPrefixOf("/office/floor1/room2/light"));
+
+  // a copy has its own nodes
+  NameTrie copy(trie);
+  copy.insert("/");
+  BOOST_CHECK(copy.hasPrefixOf("/anything"));
+  BOOST_CHECK(!trie.hasPrefixOf("/anything"));
+}
+
+BOOST_AUTO_TEST_CASE(IsPrefixOf)
+{
+  BOOST_CHECK(NameTrie::isPrefixOf("/plant/line3", "/plant/line3/pump2"));
+  BOOST_CHECK(NameTrie::isPrefixOf("/plant/line3", "/plant/line3"));
+  BOOST_CHECK(!NameTrie::isPrefixOf("/plant/line3", "/plant/line30"));
+  BOOST_CHECK(!NameTrie::isPrefixOf("/plant/line3", "/plant"));
+  BOOST_CHECK(NameTrie::isPrefixOf("/", "/plant"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace psync
@@ -0,0 +1,115 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2018,  The University of Memphis
+ *
+ * This file is part of NLSR (Named-data Link State Routing).
+ * See AUTHORS.md for complete list of NLSR authors and contributors.
+ *
+ * NLSR is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NLSR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NLSR, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include "rateless-iblt.hpp"
+#include "util.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+namespace psync {
+
+static uint32_t
+getHash(const std::string& prefix, int seq)
+{
+  return MurmurHash3(11, ParseHex(prefix + "/" + std::to_string(seq)));
+}
+
+/**
+ * @brief Feed @p remote's symbols to @p decoder in blocks of
+ *        @p blockSize until it decodes, returning the number of symbols used
+ */
+static size_t
+decodeInBlocks(RatelessIBLT& remote, RatelessDecoder& decoder, size_t blockSize)
+{
+  while (decoder.getNumSymbols() < 100000) {
+    std::vector<uint8_t> block = remote.encodeSymbols(decoder.getNumSymbols(), blockSize);
+    if (decoder.addSymbols(block.data(), blockSize)) {
+      break;
+    }
+  }
+  return decoder.getNumSymbols();
+}
+
+BOOST_AUTO_TEST_SUITE(TestRatelessIBLT)
+
+BOOST_AUTO_TEST_CASE(EqualSets)
+{
+  RatelessIBLT local, remote;
+  for (int i = 1; i <= 50; i++) {
+    local.insert(getHash("/test/memphis", i));
+    remote.insert(getHash("/test/memphis", i));
+  }
+
+  RatelessDecoder decoder(local);
+  BOOST_CHECK_EQUAL(decodeInBlocks(remote, decoder, 1), 1);
+  BOOST_CHECK(decoder.getPositive().empty());
+  BOOST_CHECK(decoder.getNegative().empty());
+}
+
+BOOST_AUTO_TEST_CASE(LargeDifference)
+{
+  RatelessIBLT local, remote;
+  std::set<uint32_t> onlyLocal, onlyRemote;
+
+  for (int i = 1; i <= 1000; i++) {
+    local.insert(getHash("/test/memphis", i));
+    remote.insert(getHash("/test/memphis", i));
+  }
+  for (int i = 1; i <= 300; i++) {
+    onlyLocal.insert(getHash("/test/delft", i));
+    local.insert(getHash("/test/delft", i));
+  }
+  for (int i = 1; i <= 200; i++) {
+    onlyRemote.insert(getHash("/test/arizona", i));
+    remote.insert(getHash("/test/arizona", i));
+  }
+
+  RatelessDecoder decoder(local);
+  size_t used = decodeInBlocks(remote, decoder, 64);
+
+  BOOST_CHECK(decoder.isDecoded());
+  BOOST_CHECK(decoder.getPositive() == onlyLocal);
+  BOOST_CHECK(decoder.getNegative() == onlyRemote);
+  // cost follows the difference (500 keys), not the set sizes
+  BOOST_CHECK_LT(used, 1500);
+}
+
+BOOST_AUTO_TEST_CASE(UpdateMaterializedSymbols)
+{
+  RatelessIBLT fresh, updated;
+
+  // materialize symbols first, then change the set
+  updated.encodeSymbols(0, 200);
+  for (int i = 1; i <= 20; i++) {
+    updated.insert(getHash("/test/memphis", i));
+  }
+  updated.erase(getHash("/test/memphis", 7));
+
+  for (int i = 1; i <= 20; i++) {
+    if (i != 7) {
+      fresh.insert(getHash("/test/memphis", i));
+    }
+  }
+
+  BOOST_CHECK(updated.encodeSymbols(0, 300) == fresh.encodeSymbols(0, 300));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace psync
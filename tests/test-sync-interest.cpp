@@ -0,0 +1,339 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2018,  The University of Memphis
+ *
+ * This file is part of NLSR (Named-data Link State Routing).
+ * See AUTHORS.md for complete list of NLSR authors and contributors.
+ *
+ * NLSR is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NLSR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NLSR, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include "sync-interest.hpp"
+#include "iblt.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+
+#include <boost/test/unit_test.hpp>
+
+namespace psync {
+
+/**
+ * @brief Sync interest name as LogicConsumer builds it
+ */
+static ndn::Name
+makeSyncInterestName(bloom_filter& bf, unsigned int count, double falsePositive,
+                     bloom_filter_type type, const IBLT& iblt, bool withDigest)
+{
+  ndn::Name name("/test/sync");
+  if (withDigest) {
+    IBLT::appendDigestToName(name, iblt.getDigest());
+  }
+  name.appendNumber(count);
+  name.appendNumber(encode_false_positive(falsePositive, type));
+  name.appendNumber(bf.getTableSize());
+  name.append(bf.begin(), bf.end());
+  iblt.appendToName(name);
+  return name;
+}
+
+BOOST_AUTO_TEST_SUITE(TestSyncInterest)
+
+BOOST_AUTO_TEST_CASE(Parse)
+{
+  bloom_parameters opt;
+  opt.projected_element_count = 20;
+  opt.false_positive_probability = 0.01;
+  opt.type = bloom_filter_double_hashing;
+  opt.compute_optimal_parameters();
+  bloom_filter bf(opt);
+  bf.insert("/test/memphis");
+
+  IBLT iblt(40);
+  iblt.insert(1234);
+
+  ndn::Name name = makeSyncInterestName(bf, 20, 0.01, bloom_filter_double_hashing, iblt, true);
+  PartialSyncInterest syncInterest;
+  BOOST_REQUIRE(parsePartialSyncInterest(name, syncInterest));
+
+  BOOST_CHECK_EQUAL(syncInterest.bloomParameters.projected_element_count, 20);
+  BOOST_CHECK_EQUAL(syncInterest.bloomParameters.type, bloom_filter_double_hashing);
+  BOOST_CHECK_EQUAL(syncInterest.bloomTableSize, bf.getTableSize());
+  // points into the name
+  BOOST_CHECK(syncInterest.bloomTable == name.get(-3).value());
+  BOOST_CHECK(syncInterest.ibltHeader == &name.get(-2));
+  BOOST_CHECK(syncInterest.ibltTable == &name.get(-1));
+  BOOST_CHECK(syncInterest.hasDigest);
+  BOOST_CHECK_EQUAL(syncInterest.digest, iblt.getDigest());
+
+  bloom_filter received = syncInterest.getBloomFilter();
+  BOOST_CHECK(received.contains("/test/memphis"));
+  BOOST_CHECK(!received.contains("/test/csu"));
+
+  // a copy owns its bytes and can be added to
+  bloom_filter copy(received);
+  copy.insert("/test/csu");
+  BOOST_CHECK(copy.contains("/test/csu"));
+  BOOST_CHECK(!received.contains("/test/csu"));
+
+  // without the digest, from a consumer that predates it
+  name = makeSyncInterestName(bf, 20, 0.01, bloom_filter_double_hashing, iblt, false);
+  BOOST_REQUIRE(parsePartialSyncInterest(name, syncInterest));
+  BOOST_CHECK(!syncInterest.hasDigest);
+}
+
+BOOST_AUTO_TEST_CASE(CompressedBloomFilter)
+{
+  bloom_parameters opt;
+  opt.projected_element_count = 200;
+  opt.false_positive_probability = 0.001;
+  opt.compute_optimal_parameters();
+  bloom_filter bf(opt);
+  bf.insert("/test/memphis");
+  IBLT iblt(40);
+
+  std::vector<uint8_t> compressed;
+  compress_bloom_table(&*bf.begin(), bf.getTableSize(), compressed);
+  BOOST_REQUIRE_LT(compressed.size(), bf.getTableSize());
+
+  ndn::Name name("/test/sync");
+  name.appendNumber(200);
+  name.appendNumber(encode_false_positive(0.001, bloom_filter_salted));
+  name.appendNumber(bf.getTableSize());
+  name.append(compressed.data(), compressed.size());
+  iblt.appendToName(name);
+
+  PartialSyncInterest syncInterest;
+  BOOST_REQUIRE(parsePartialSyncInterest(name, syncInterest));
+  BOOST_CHECK_EQUAL(syncInterest.bloomTableSize, bf.getTableSize());
+  bloom_filter received = syncInterest.getBloomFilter();
+  BOOST_CHECK(received.contains("/test/memphis"));
+  BOOST_CHECK(received.table() == bf.table());
+
+  // A few compressed bytes cannot make the producer allocate a huge table
+  bloom_parameters large;
+  large.projected_element_count = 100000000;
+  large.false_positive_probability = 0.001;
+  large.compute_optimal_parameters();
+  BOOST_REQUIRE_GT(large.optimal_parameters.table_size / bits_per_char, MAX_BLOOM_TABLE_SIZE);
+
+  name = ndn::Name("/test/sync");
+  name.appendNumber(large.projected_element_count);
+  name.appendNumber(encode_false_positive(0.001, bloom_filter_salted));
+  name.appendNumber(large.optimal_parameters.table_size / bits_per_char);
+  name.append(compressed.data(), compressed.size());
+  iblt.appendToName(name);
+  BOOST_CHECK(!parsePartialSyncInterest(name, syncInterest));
+  BOOST_CHECK(syncInterest.bloomBuffer.size() <= MAX_BLOOM_TABLE_SIZE);
+}
+
+BOOST_AUTO_TEST_CASE(SubscriptionOutlivesInterest)
+{
+  bloom_parameters opt;
+  opt.projected_element_count = 200;
+  opt.false_positive_probability = 0.001;
+  opt.compute_optimal_parameters();
+  bloom_filter bf(opt);
+  bf.insert("/test/memphis");
+  IBLT iblt(40);
+
+  std::vector<uint8_t> compressed;
+  compress_bloom_table(&*bf.begin(), bf.getTableSize(), compressed);
+
+  // as pending entries keep it: moved out, after the interest is gone
+  Subscription subscription;
+  {
+    ndn::Name name("/test/sync");
+    name.appendNumber(200);
+    name.appendNumber(encode_false_positive(0.001, bloom_filter_salted));
+    name.appendNumber(bf.getTableSize());
+    name.append(compressed.data(), compressed.size());
+    iblt.appendToName(name);
+
+    PartialSyncInterest syncInterest;
+    BOOST_REQUIRE(parsePartialSyncInterest(name, syncInterest));
+    subscription = syncInterest.getSubscription();
+    std::fill(syncInterest.bloomBuffer.begin(), syncInterest.bloomBuffer.end(), 0);
+  }
+  Subscription pending(std::move(subscription));
+  BOOST_CHECK(pending.contains("/test/memphis"));
+  BOOST_CHECK(pending.bf.table() == bf.table());
+}
+
+BOOST_AUTO_TEST_CASE(SubscribeAll)
+{
+  IBLT iblt(40);
+  iblt.insert(1234);
+
+  ndn::Name name("/test/sync");
+  IBLT::appendDigestToName(name, iblt.getDigest());
+  appendSubscribeAllToName(name);
+  iblt.appendToName(name);
+
+  PartialSyncInterest syncInterest;
+  BOOST_REQUIRE(parsePartialSyncInterest(name, syncInterest));
+  BOOST_CHECK(syncInterest.isSubscribeAll);
+  BOOST_CHECK(syncInterest.ibltHeader == &name.get(-2));
+  BOOST_CHECK(syncInterest.hasDigest);
+  BOOST_CHECK_EQUAL(syncInterest.digest, iblt.getDigest());
+  BOOST_CHECK_EQUAL(syncInterest.getBloomFilter().getTableSize(), 0);
+
+  name = ndn::Name("/test/sync");
+  appendSubscribeAllToName(name);
+  iblt.appendToName(name);
+  BOOST_REQUIRE(parsePartialSyncInterest(name, syncInterest));
+  BOOST_CHECK(syncInterest.isSubscribeAll);
+  BOOST_CHECK(!syncInterest.hasDigest);
+
+  // a one-byte Bloom filter that happens to hold the marker byte
+  bloom_parameters opt;
+  opt.projected_element_count = 1;
+  opt.false_positive_probability = 0.5;
+  opt.compute_optimal_parameters();
+  BOOST_REQUIRE_EQUAL(opt.optimal_parameters.table_size, 8);
+  name = ndn::Name("/test/sync");
+  name.appendNumber(1);
+  name.appendNumber(encode_false_positive(0.5, bloom_filter_salted));
+  name.appendNumber(1);
+  appendSubscribeAllToName(name);
+  iblt.appendToName(name);
+  BOOST_REQUIRE(parsePartialSyncInterest(name, syncInterest));
+  BOOST_CHECK(!syncInterest.isSubscribeAll);
+  BOOST_CHECK_EQUAL(syncInterest.bloomTableSize, 1);
+}
+
+BOOST_AUTO_TEST_CASE(Subtrees)
+{
+  bloom_parameters opt;
+  opt.projected_element_count = 20;
+  opt.false_positive_probability = 0.001;
+  opt.compute_optimal_parameters();
+  bloom_filter bf(opt);
+  IBLT iblt(40);
+
+  ndn::Name name("/test/sync");
+  IBLT::appendDigestToName(name, iblt.getDigest());
+  appendSubtreesToName(name, {"/plant/line3", "/office"});
+  name.appendNumber(20);
+  name.appendNumber(encode_false_positive(0.001, bloom_filter_salted));
+  name.appendNumber(bf.getTableSize());
+  name.append(bf.begin(), bf.end());
+  iblt.appendToName(name);
+
+  PartialSyncInterest syncInterest;
+  BOOST_REQUIRE(parsePartialSyncInterest(name, syncInterest));
+  BOOST_CHECK(syncInterest.hasDigest);
+  BOOST_CHECK(syncInterest.isBloomFilterEmpty);
+  BOOST_CHECK_EQUAL(syncInterest.subtrees.size(), 2);
+
+  Subscription subscription = syncInterest.getSubscription();
+  BOOST_CHECK(subscription.contains("/plant/line3/pump2"));
+  BOOST_CHECK(subscription.contains("/office/floor1"));
+  BOOST_CHECK(!subscription.contains("/plant/line4/pump2"));
+
+  // along with exact prefixes in the Bloom filter
+  bf.insert("/plant/line4/pump2");
+  name = ndn::Name("/test/sync");
+  appendSubtreesToName(name, {"/plant/line3"});
+  name.appendNumber(20);
+  name.appendNumber(encode_false_positive(0.001, bloom_filter_salted));
+  name.appendNumber(bf.getTableSize());
+  name.append(bf.begin(), bf.end());
+  iblt.appendToName(name);
+  BOOST_REQUIRE(parsePartialSyncInterest(name, syncInterest));
+  BOOST_CHECK(!syncInterest.hasDigest);
+  BOOST_CHECK(!syncInterest.isBloomFilterEmpty);
+  subscription = syncInterest.getSubscription();
+  BOOST_CHECK(subscription.contains("/plant/line3/pump2"));
+  BOOST_CHECK(subscription.contains("/plant/line4/pump2"));
+  BOOST_CHECK(!subscription.contains("/plant/line4/pump3"));
+
+  // a length running past the component
+  const uint8_t truncated[] = {MARKER_SUBTREE, 0, 10, '/', 'a'};
+  name = ndn::Name("/test/sync");
+  name.append(truncated, sizeof(truncated));
+  name.appendNumber(20);
+  name.appendNumber(encode_false_positive(0.001, bloom_filter_salted));
+  name.appendNumber(bf.getTableSize());
+  name.append(bf.begin(), bf.end());
+  iblt.appendToName(name);
+  BOOST_CHECK(!parsePartialSyncInterest(name, syncInterest));
+}
+
+BOOST_AUTO_TEST_CASE(Malformed)
+{
+  bloom_parameters opt;
+  opt.projected_element_count = 20;
+  opt.false_positive_probability = 0.01;
+  opt.compute_optimal_parameters();
+  bloom_filter bf(opt);
+  IBLT iblt(40);
+  PartialSyncInterest syncInterest;
+
+  // the Bloom filter does not have the size of the parameters sent with it
+  ndn::Name name = makeSyncInterestName(bf, 200, 0.01, bloom_filter_salted, iblt, false);
+  BOOST_CHECK(!parsePartialSyncInterest(name, syncInterest));
+
+  name = makeSyncInterestName(bf, 20, 0.01, bloom_filter_salted, iblt, false);
+  BOOST_CHECK(parsePartialSyncInterest(name, syncInterest));
+  BOOST_CHECK(!parsePartialSyncInterest(name.getPrefix(-1), syncInterest));
+  BOOST_CHECK(!parsePartialSyncInterest(ndn::Name("/test/sync"), syncInterest));
+
+  // degenerate parameters, sent with the table size they compute to
+  auto makeDegenerateName = [&iblt] (unsigned int count, double falsePositive) {
+    bloom_parameters degenerate;
+    degenerate.projected_element_count = count;
+    degenerate.false_positive_probability = falsePositive;
+    degenerate.compute_optimal_parameters();
+    std::vector<uint8_t> table(degenerate.optimal_parameters.table_size / bits_per_char, 0);
+    ndn::Name name("/test/sync");
+    name.appendNumber(count);
+    name.appendNumber(encode_false_positive(falsePositive, bloom_filter_salted));
+    name.appendNumber(table.size());
+    name.append(table.data(), table.size());
+    iblt.appendToName(name);
+    return name;
+  };
+  BOOST_CHECK(parsePartialSyncInterest(makeDegenerateName(20, 0.01), syncInterest));
+  BOOST_CHECK(!parsePartialSyncInterest(makeDegenerateName(0, 0.01), syncInterest));
+  BOOST_CHECK(!parsePartialSyncInterest(makeDegenerateName(20, 0), syncInterest));
+  BOOST_CHECK(!parsePartialSyncInterest(makeDegenerateName(20, 1), syncInterest));
+  BOOST_CHECK(!parsePartialSyncInterest(makeDegenerateName(20, 2), syncInterest));
+}
+
+BOOST_AUTO_TEST_CASE(FullStateContent)
+{
+  std::map<std::string, uint32_t> prefixes{{"/a/1", 2}, {"/a/2", 0}, {"/b/1", 5}};
+  std::string content;
+  bool isCurrent = false;
+
+  BOOST_CHECK_EQUAL(getFullStateContent(prefixes, content, isCurrent), "/a/1 2\n/b/1 5\n");
+  BOOST_CHECK(isCurrent);
+
+  // kept until the caller marks it stale
+  prefixes["/a/2"] = 1;
+  BOOST_CHECK_EQUAL(getFullStateContent(prefixes, content, isCurrent), "/a/1 2\n/b/1 5\n");
+  isCurrent = false;
+  BOOST_CHECK_EQUAL(getFullStateContent(prefixes, content, isCurrent),
+                    "/a/1 2\n/a/2 1\n/b/1 5\n");
+
+  Subscription subscription;
+  subscription.subtrees.insert("/a");
+  BOOST_CHECK_EQUAL(getFullStateContent(prefixes, content, isCurrent, subscription),
+                    "/a/1 2\n/a/2 1\n");
+  subscription.isSubscribeAll = true;
+  BOOST_CHECK_EQUAL(getFullStateContent(prefixes, content, isCurrent, subscription), content);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace psync
@@ -0,0 +1,384 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2018,  The University of Memphis
+ *
+ * This file is part of NLSR (Named-data Link State Routing).
+ * See AUTHORS.md for complete list of NLSR authors and contributors.
+ *
+ * NLSR is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NLSR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NLSR, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/* Micro-benchmarks of the IBLT operations on the sync path
+ *
+ * usage: psync-bench [--min-time <ms>] [<expectedNumEntries>...]
+ *
+ * Prints one JSON object with the time (ns/op) and the number of heap
+ * allocations (allocs/op) of each operation for each table size, and the
+ * size in a sync interest and producer lookup time of each subscription
+ * filter type. Keys are drawn from a fixed seed so that runs compare.
+ */
+
+#include "bloom-filter.hpp"
+#include "cuckoo-filter.hpp"
+#include "iblt.hpp"
+#include "simd.hpp"
+
+#include <ndn-cxx/name.hpp>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace psync;
+
+static std::atomic<uint64_t> g_numAllocations(0);
+
+void*
+operator new(std::size_t size)
+{
+  g_numAllocations++;
+  void* p = std::malloc(size == 0 ? 1 : size);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+// not inlined, or GCC sees free() paired with operator new and warns
+__attribute__((noinline)) void
+operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+void
+operator delete(void* p, std::size_t) noexcept
+{
+  operator delete(p);
+}
+
+#ifdef __GLIBC__
+// The IBLT cell arrays (simd::AlignedVector) bypass operator new and come
+// from posix_memalign, count them as well
+extern "C" void* __libc_memalign(std::size_t alignment, std::size_t size);
+
+extern "C" int
+posix_memalign(void** p, std::size_t alignment, std::size_t size)
+{
+  g_numAllocations++;
+  *p = __libc_memalign(alignment, size);
+  return *p == nullptr ? ENOMEM : 0;
+}
+#endif
+
+namespace {
+
+struct Result
+{
+  std::string operation;
+  size_t expectedNumEntries;
+  size_t numCells;
+  size_t difference;
+  double nsPerOp;
+  double allocsPerOp;
+};
+
+struct FilterResult
+{
+  std::string type;
+  size_t numSubscriptions;
+  double falsePositive;
+  size_t tableSize;
+  double nsPerContains;
+};
+
+/**
+ * @brief Run @p op in growing batches until they take at least @p minTime
+ */
+template<typename Op>
+std::pair<double, double>
+measure(const Op& op, std::chrono::milliseconds minTime)
+{
+  typedef std::chrono::steady_clock Clock;
+
+  // warm up caches and any buffer that grows on first use
+  op();
+
+  uint64_t numIterations = 1;
+  while (true) {
+    uint64_t numAllocationsBefore = g_numAllocations;
+    Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; i < numIterations; i++) {
+      op();
+    }
+    Clock::duration elapsed = Clock::now() - start;
+    uint64_t numAllocations = g_numAllocations - numAllocationsBefore;
+
+    if (elapsed >= minTime || numIterations >= (uint64_t(1) << 32)) {
+      double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+      return {ns / numIterations, double(numAllocations) / numIterations};
+    }
+    numIterations *= 2;
+  }
+}
+
+class Bench
+{
+public:
+  explicit
+  Bench(std::chrono::milliseconds minTime)
+    : m_minTime(minTime)
+    , m_rng(42)
+  {
+  }
+
+  void
+  run(size_t expectedNumEntries)
+  {
+    std::vector<uint32_t> keys(expectedNumEntries);
+    for (auto& key : keys) {
+      key = m_rng();
+    }
+
+    IBLT full(expectedNumEntries);
+    for (uint32_t key : keys) {
+      full.insert(key);
+    }
+    size_t numCells = full.getNumEntry();
+
+    std::vector<uint32_t> extraKeys(1024);
+    for (auto& key : extraKeys) {
+      key = m_rng();
+    }
+
+    {
+      IBLT iblt(full);
+      size_t i = 0;
+      add("insert", expectedNumEntries, numCells, 0, measure([&] {
+        iblt.insert(extraKeys[i++ % extraKeys.size()]);
+      }, m_minTime));
+      i = 0;
+      add("erase", expectedNumEntries, numCells, 0, measure([&] {
+        iblt.erase(extraKeys[i++ % extraKeys.size()]);
+      }, m_minTime));
+    }
+
+    {
+      IBLT other(full);
+      other.insert(extraKeys[0]);
+      add("operator-", expectedNumEntries, numCells, 1, measure([&] {
+        IBLT diff = full - other;
+      }, m_minTime));
+
+      IBLT copy(full);
+      bool isEqual = false;
+      add("operator==", expectedNumEntries, numCells, 0, measure([&] {
+        isEqual ^= (full == copy);
+      }, m_minTime));
+    }
+
+    IBLT::PeelWorkspace workspace;
+    std::vector<uint32_t> positive, negative;
+    for (size_t difference = 1; difference <= expectedNumEntries / 2; difference *= 10) {
+      // half of the difference on each side
+      IBLT other(full);
+      for (size_t i = 0; i < difference; i++) {
+        if (i % 2 == 0) {
+          other.erase(keys[i]);
+        }
+        else {
+          other.insert(m_rng());
+        }
+      }
+      IBLT diff = full - other;
+      add("listEntries", expectedNumEntries, numCells, difference, measure([&] {
+        positive.clear();
+        negative.clear();
+        diff.listEntries(positive, negative, workspace);
+      }, m_minTime));
+    }
+
+    const std::pair<IBLTWireFormat, std::string> formats[] = {
+      {IBLT_WIRE_PLAIN, "plain"},
+      {IBLT_WIRE_COMPACT, "compact"},
+    };
+    for (const auto& format : formats) {
+      IBLT iblt(full);
+      // the encoding is cached until the table changes, so change it every time
+      add("appendToName/" + format.second, expectedNumEntries, numCells, 0, measure([&] {
+        iblt.insert(extraKeys[0]);
+        iblt.erase(extraKeys[0]);
+        ndn::Name name;
+        iblt.appendToName(name, format.first);
+      }, m_minTime));
+
+      add("appendToName/" + format.second + "/cached", expectedNumEntries, numCells, 0,
+          measure([&] {
+            ndn::Name name;
+            iblt.appendToName(name, format.first);
+          }, m_minTime));
+
+      ndn::Name name;
+      iblt.appendToName(name, format.first);
+      add("getIBLTFromName/" + format.second, expectedNumEntries, numCells, 0, measure([&] {
+        IBLT decoded = full.getIBLTFromName(name.get(-2), name.get(-1));
+      }, m_minTime));
+    }
+  }
+
+  /**
+   * @brief Subscription filters of @p numSubscriptions prefixes as a producer
+   *        reads them from a sync interest, looked up with as many prefixes
+   *        in as out
+   */
+  void
+  runFilters(size_t numSubscriptions)
+  {
+    const std::pair<bloom_filter_type, std::string> types[] = {
+      {bloom_filter_salted, "salted"},
+      {bloom_filter_blocked, "blocked"},
+      {bloom_filter_double_hashing, "double_hashing"},
+      {bloom_filter_cuckoo, "cuckoo"},
+    };
+
+    std::vector<std::string> prefixes;
+    for (size_t i = 0; i < 2 * numSubscriptions; i++) {
+      prefixes.push_back("/ndn/edu/memphis/sensor/" + std::to_string(m_rng()));
+    }
+
+    for (double falsePositive : {0.01, 0.001, 0.0001, 0.00001}) {
+      for (const auto& type : types) {
+        bloom_parameters opt;
+        opt.projected_element_count = numSubscriptions;
+        opt.false_positive_probability = falsePositive;
+        opt.type = type.first;
+        opt.compute_optimal_parameters();
+
+        std::vector<uint8_t> table;
+        if (type.first == bloom_filter_cuckoo) {
+          cuckoo_filter cf(opt);
+          for (size_t i = 0; i < numSubscriptions; i++) {
+            cf.insert(prefixes[i]);
+          }
+          table = cf.table();
+        }
+        else {
+          bloom_filter bf(opt);
+          for (size_t i = 0; i < numSubscriptions; i++) {
+            bf.insert(prefixes[i]);
+          }
+          table = bf.table();
+        }
+
+        bloom_filter received(opt, table.data(), table.size());
+        size_t i = 0;
+        bool isFound = false;
+        double ns = measure([&] {
+          isFound ^= received.contains(prefixes[i++ % prefixes.size()]);
+        }, m_minTime).first;
+
+        m_filterResults.push_back({type.second, numSubscriptions, falsePositive,
+                                   table.size(), ns});
+        std::cerr << "contains/" << type.second << " " << numSubscriptions << " "
+                  << falsePositive << ": " << table.size() << " bytes, "
+                  << ns << " ns/op" << std::endl;
+      }
+    }
+  }
+
+  void
+  print(std::ostream& os) const
+  {
+    os << "{\n"
+       << "  \"simd\": \"" << simd::getImplementation() << "\",\n"
+       << "  \"minTimeMs\": " << m_minTime.count() << ",\n"
+       << "  \"results\": [";
+    for (size_t i = 0; i < m_results.size(); i++) {
+      const Result& r = m_results[i];
+      os << (i == 0 ? "\n" : ",\n")
+         << "    {\"operation\": \"" << r.operation << "\""
+         << ", \"expectedNumEntries\": " << r.expectedNumEntries
+         << ", \"numCells\": " << r.numCells
+         << ", \"difference\": " << r.difference
+         << ", \"nsPerOp\": " << r.nsPerOp
+         << ", \"allocsPerOp\": " << r.allocsPerOp << "}";
+    }
+    os << "\n  ],\n"
+       << "  \"subscriptionFilters\": [";
+    for (size_t i = 0; i < m_filterResults.size(); i++) {
+      const FilterResult& r = m_filterResults[i];
+      os << (i == 0 ? "\n" : ",\n")
+         << "    {\"type\": \"" << r.type << "\""
+         << ", \"numSubscriptions\": " << r.numSubscriptions
+         << ", \"falsePositive\": " << r.falsePositive
+         << ", \"tableSize\": " << r.tableSize
+         << ", \"nsPerContains\": " << r.nsPerContains << "}";
+    }
+    os << "\n  ]\n}\n";
+  }
+
+private:
+  void
+  add(const std::string& operation, size_t expectedNumEntries, size_t numCells,
+      size_t difference, std::pair<double, double> measured)
+  {
+    m_results.push_back({operation, expectedNumEntries, numCells, difference,
+                         measured.first, measured.second});
+    std::cerr << operation << " " << expectedNumEntries << " " << difference << ": "
+              << measured.first << " ns/op, " << measured.second << " allocs/op" << std::endl;
+  }
+
+private:
+  std::chrono::milliseconds m_minTime;
+  std::mt19937 m_rng;
+  std::vector<Result> m_results;
+  std::vector<FilterResult> m_filterResults;
+};
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  std::chrono::milliseconds minTime(200);
+  std::vector<size_t> sizes;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--min-time" && i + 1 < argc) {
+      minTime = std::chrono::milliseconds(std::atoi(argv[++i]));
+    }
+    else if (arg.empty() || arg[0] == '-' || std::atol(arg.c_str()) <= 0) {
+      std::cerr << "usage: " << argv[0] << " [--min-time <ms>] [<expectedNumEntries>...]\n";
+      return 2;
+    }
+    else {
+      sizes.push_back(std::atol(arg.c_str()));
+    }
+  }
+  if (sizes.empty()) {
+    sizes = {80, 1000, 10000, 100000};
+  }
+
+  Bench bench(minTime);
+  for (size_t size : sizes) {
+    bench.run(size);
+  }
+  for (size_t numSubscriptions : {10, 100, 1000}) {
+    bench.runFilters(numSubscriptions);
+  }
+  bench.print(std::cout);
+}
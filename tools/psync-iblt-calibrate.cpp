@@ -0,0 +1,253 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2018,  The University of Memphis
+ *
+ * This file is part of NLSR (Named-data Link State Routing).
+ * See AUTHORS.md for complete list of NLSR authors and contributors.
+ *
+ * NLSR is free software: you can redistribute it and/or modify it under the terms
+ * of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * NLSR is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * NLSR, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/* Monte Carlo calibration of the IBLT size
+ *
+ * usage: psync-iblt-calibrate [--trials <n>] [--target <failure rate>]
+ *                             [--state <entries>] [<difference>...]
+ *
+ * For each difference size, hash count (3 or 4) and expectedNumEntries from
+ * half to three times the difference, two peers with that many differing
+ * entries exchange their IBLT through appendToName and listDifference, and
+ * the share of trials that do not peel is the failure rate. Entries both
+ * peers hold cancel out exactly and do not change it, so trials only insert
+ * the difference.
+ *
+ * The name size is that of a table holding --state entries (by default
+ * expectedNumEntries), as a node's full table would, in the plain and the
+ * compact format. The output is one JSON object with every configuration and,
+ * per difference, the smallest expectedNumEntries whose failure rate is at
+ * most --target. A rate below 1/trials cannot be told from zero.
+ */
+
+#include "iblt.hpp"
+
+#include <ndn-cxx/name.hpp>
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace psync;
+
+namespace {
+
+struct Config
+{
+  size_t nHash;
+  size_t difference;
+  size_t expectedNumEntries;
+  size_t numCells;
+  double failureRate;
+  size_t plainBytes;
+  size_t compactBytes;
+};
+
+class Calibration
+{
+public:
+  Calibration(size_t numTrials, size_t numStateEntries)
+    : m_numTrials(numTrials)
+    , m_numStateEntries(numStateEntries)
+    , m_rng(42)
+  {
+  }
+
+  template<size_t NHash>
+  void
+  run(size_t difference)
+  {
+    size_t step = std::max<size_t>(1, difference / 10);
+    for (size_t expected = std::max<size_t>(1, difference / 2); expected <= 3 * difference;
+         expected += step) {
+      m_configs.push_back(measure<IBLTTraits<NHash, uint32_t, int32_t>>(difference, expected));
+    }
+  }
+
+  void
+  print(std::ostream& os, double target) const
+  {
+    os << "{\n"
+       << "  \"trials\": " << m_numTrials << ",\n"
+       << "  \"target\": " << target << ",\n"
+       << "  \"results\": [";
+    for (size_t i = 0; i < m_configs.size(); i++) {
+      os << (i == 0 ? "\n" : ",\n") << "    ";
+      print(os, m_configs[i]);
+    }
+    os << "\n  ],\n"
+       << "  \"recommendations\": [";
+
+    // smallest name meeting the target for each difference, over both hash counts;
+    // larger tables with the same hash count must meet it too, so that a lucky
+    // run near the threshold is not picked
+    bool isFirst = true;
+    for (size_t i = 0; i < m_configs.size(); i++) {
+      size_t difference = m_configs[i].difference;
+      if (i > 0 && m_configs[i - 1].difference == difference) {
+        continue;
+      }
+      const Config* best = nullptr;
+      for (size_t j = i; j < m_configs.size() && m_configs[j].difference == difference; j++) {
+        if (meetsTarget(j, target) &&
+            (best == nullptr || m_configs[j].plainBytes < best->plainBytes)) {
+          best = &m_configs[j];
+        }
+      }
+      if (best != nullptr) {
+        os << (isFirst ? "\n" : ",\n") << "    ";
+        print(os, *best);
+        isFirst = false;
+      }
+    }
+    os << "\n  ]\n}\n";
+  }
+
+private:
+  bool
+  meetsTarget(size_t i, double target) const
+  {
+    for (size_t j = i; j < m_configs.size(); j++) {
+      if (m_configs[j].difference == m_configs[i].difference &&
+          m_configs[j].nHash == m_configs[i].nHash && m_configs[j].failureRate > target) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  template<typename Traits>
+  Config
+  measure(size_t difference, size_t expectedNumEntries)
+  {
+    typedef BasicIBLT<Traits> Table;
+
+    typename Table::PeelWorkspace workspace;
+    std::set<uint32_t> positive, negative;
+    size_t numFailures = 0;
+    for (size_t trial = 0; trial < m_numTrials; trial++) {
+      Table own(expectedNumEntries), other(expectedNumEntries);
+      for (size_t i = 0; i < difference; i++) {
+        (i % 2 == 0 ? own : other).insert(m_rng());
+      }
+
+      ndn::Name name;
+      other.appendToName(name);
+      positive.clear();
+      negative.clear();
+      if (!own.listDifference(name.get(-2), name.get(-1), positive, negative, workspace) ||
+          positive.size() + negative.size() != difference) {
+        numFailures++;
+      }
+    }
+
+    Table state(expectedNumEntries);
+    size_t numStateEntries = m_numStateEntries == 0 ? expectedNumEntries : m_numStateEntries;
+    for (size_t i = 0; i < numStateEntries; i++) {
+      state.insert(m_rng());
+    }
+    ndn::Name plain, compact;
+    state.appendToName(plain, IBLT_WIRE_PLAIN);
+    state.appendToName(compact, IBLT_WIRE_COMPACT);
+
+    Config config;
+    config.nHash = Traits::N_HASH;
+    config.difference = difference;
+    config.expectedNumEntries = expectedNumEntries;
+    config.numCells = state.getNumEntry();
+    config.failureRate = double(numFailures) / m_numTrials;
+    config.plainBytes = plain.get(-2).value_size() + plain.get(-1).value_size();
+    config.compactBytes = compact.get(-2).value_size() + compact.get(-1).value_size();
+    std::cerr << "nHash " << config.nHash << " difference " << difference
+              << " expectedNumEntries " << expectedNumEntries
+              << ": failure rate " << config.failureRate << std::endl;
+    return config;
+  }
+
+  static void
+  print(std::ostream& os, const Config& config)
+  {
+    os << "{\"nHash\": " << config.nHash
+       << ", \"difference\": " << config.difference
+       << ", \"expectedNumEntries\": " << config.expectedNumEntries
+       << ", \"numCells\": " << config.numCells
+       << ", \"failureRate\": " << config.failureRate
+       << ", \"plainBytes\": " << config.plainBytes
+       << ", \"compactBytes\": " << config.compactBytes << "}";
+  }
+
+private:
+  size_t m_numTrials;
+  size_t m_numStateEntries;
+  std::mt19937 m_rng;
+  std::vector<Config> m_configs;
+};
+
+void
+usage(const char* program)
+{
+  std::cerr << "usage: " << program << " [--trials <n>] [--target <failure rate>]"
+            << " [--state <entries>] [<difference>...]\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  size_t numTrials = 1000;
+  double target = 0.01;
+  size_t numStateEntries = 0;
+  std::vector<size_t> differences;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--trials" && i + 1 < argc) {
+      numTrials = std::atol(argv[++i]);
+    }
+    else if (arg == "--target" && i + 1 < argc) {
+      target = std::atof(argv[++i]);
+    }
+    else if (arg == "--state" && i + 1 < argc) {
+      numStateEntries = std::atol(argv[++i]);
+    }
+    else if (!arg.empty() && arg[0] != '-' && std::atol(arg.c_str()) > 0) {
+      differences.push_back(std::atol(arg.c_str()));
+    }
+    else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (numTrials == 0) {
+    usage(argv[0]);
+    return 2;
+  }
+  if (differences.empty()) {
+    differences = {10, 40, 100};
+  }
+
+  Calibration calibration(numTrials, numStateEntries);
+  for (size_t difference : differences) {
+    calibration.run<3>(difference);
+    calibration.run<4>(difference);
+  }
+  calibration.print(std::cout, target);
+}